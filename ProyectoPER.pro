@@ -12,6 +12,8 @@ SOURCES += \
     src/profiledialog.cpp \
     src/resultsdialog.cpp \
     src/usermanager.cpp \
+    src/avatarstore.cpp \
+    src/sessionwritequeue.cpp \
     src/problemmanager.cpp \
     src/chartscene.cpp \
     src/chartview.cpp \
@@ -21,7 +23,18 @@ SOURCES += \
     src/compassitem.cpp \
     src/logindialog.cpp \
     src/navigation.cpp \
-    src/navigationdao.cpp
+    src/navigationdao.cpp \
+    src/navconnectionprofile.cpp \
+    src/asyncnavigationdao.cpp \
+    src/navconnectionmanager.cpp \
+    src/navquerystats.cpp \
+    src/navcommandline.cpp \
+    src/navlockstress.cpp \
+    src/navoptionscodec.cpp \
+    src/navoptionsbench.cpp \
+    src/navloadbench.cpp \
+    src/navrowdecoderbench.cpp \
+    src/navsyntheticdataset.cpp
 
 HEADERS += \
     include/chartscene.h \
@@ -35,8 +48,23 @@ HEADERS += \
     include/ruleritem.h \
     include/distanceitem.h \
     include/usermanager.h \
+    include/avatarstore.h \
+    include/sessionwritequeue.h \
+    include/userrecords.h \
     include/navigation.h \
     include/navigationdao.h \
+    include/navconnectionprofile.h \
+    include/navrowdecoder.h \
+    include/asyncnavigationdao.h \
+    include/navconnectionmanager.h \
+    include/navquerystats.h \
+    include/navcommandline.h \
+    include/navlockstress.h \
+    include/navoptionscodec.h \
+    include/navoptionsbench.h \
+    include/navloadbench.h \
+    include/navrowdecoderbench.h \
+    include/navsyntheticdataset.h \
     include/compassitem.h \
     include/logindialog.h \
     include/navdaoexception.h \
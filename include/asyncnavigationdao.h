@@ -0,0 +1,76 @@
+#pragma once
+
+#include "navigationdao.h"
+
+#include <QFuture>
+#include <QObject>
+#include <QPromise>
+#include <QThread>
+
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Runs NavigationDAO work on a dedicated thread that owns its own
+// connection, so the GUI thread never waits on SQLite. Jobs run one at a
+// time in submission order; failures surface as NavDAOException when the
+// returned future is read. The synchronous NavigationDAO stays available.
+class AsyncNavigationDAO
+{
+public:
+    explicit AsyncNavigationDAO(const QString &dbFilePath);
+    ~AsyncNavigationDAO();
+
+    QFuture<QMap<QString, User>> loadUsers();
+    QFuture<QVector<Problem>>    loadProblems();
+    QFuture<void>                addSession(const QString &nickName, const Session &session);
+    // Resolves to the stored user, with insertedInDb() set.
+    QFuture<User>                saveUser(const User &user);
+
+    // Blocks until every job submitted so far has finished.
+    void waitForIdle();
+
+    // Queues fn(NavigationDAO &) on the database thread.
+    template <typename Fn>
+    auto run(Fn &&fn) -> QFuture<std::invoke_result_t<Fn, NavigationDAO &>>;
+
+private:
+    class Worker;
+
+    NavigationDAO &workerDao();
+
+    AsyncNavigationDAO(const AsyncNavigationDAO &) = delete;
+    AsyncNavigationDAO &operator=(const AsyncNavigationDAO &) = delete;
+
+    QString  m_dbFilePath;
+    QThread  m_thread;
+    QObject *m_worker = nullptr;
+    // Created, used and destroyed on m_thread only.
+    std::unique_ptr<NavigationDAO> m_dao;
+};
+
+template <typename Fn>
+auto AsyncNavigationDAO::run(Fn &&fn) -> QFuture<std::invoke_result_t<Fn, NavigationDAO &>>
+{
+    using Result = std::invoke_result_t<Fn, NavigationDAO &>;
+
+    auto promise = std::make_shared<QPromise<Result>>();
+    QFuture<Result> future = promise->future();
+    promise->start();
+
+    QMetaObject::invokeMethod(m_worker, [this, promise, job = std::forward<Fn>(fn)]() mutable {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                job(workerDao());
+            } else {
+                promise->addResult(job(workerDao()));
+            }
+        } catch (...) {
+            promise->setException(std::current_exception());
+        }
+        promise->finish();
+    }, Qt::QueuedConnection);
+
+    return future;
+}
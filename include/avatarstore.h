@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+
+// Avatars stored by content: <sha256 of the pixels>.png plus square
+// thumbnails for each display size, written once when the image is stored.
+class AvatarStore {
+public:
+    static constexpr int kThumbnailSizes[] = {40, 96};
+
+    explicit AvatarStore(QString directory);
+
+    // Returns the stored file name, relative to the directory, or an empty
+    // string on failure. Storing the same pixels twice reuses the files.
+    QString store(const QImage &image, QString &errorMessage) const;
+
+    // Absolute path of the size x size thumbnail of a stored name, or an
+    // empty string when the name has none (older avatars, resources).
+    QString thumbnailPath(const QString &storedName, int size) const;
+
+    static QString contentHash(const QImage &image);
+
+private:
+    QString absolutePath(const QString &fileName) const;
+    bool writePng(const QImage &image, const QString &fileName) const;
+
+    QString directory_;
+};
@@ -91,6 +91,9 @@ private:
     struct HistorySessionSource;
 
     void setupUi();
+    void startDataLoad();
+    void finishDataLoad();
+    void failDataLoad(const QString &message);
     QWidget *createToolStrip(QWidget *parent);
     void buildToolButtons(QWidget *toolStrip);
     void updateToolStripLayout();
@@ -102,6 +105,8 @@ private:
     void updateAnswerOptions();
     void recordSessionIfNeeded();
     void resetAnswerSelection();
+    // Grows answerOptions_ to at least count buttons.
+    void ensureAnswerOptions(int count);
     void applyAppTheme();
     void refreshColorPalette();
     void handleColorSelection(const QColor &color);
@@ -146,6 +151,9 @@ private:
     QPushButton *guestLoginButton_ = nullptr;
     QLabel *loginFeedbackLabel_ = nullptr;
     bool guestSessionActive_ = false;
+    // Users and problems are in; login and registration wait for it.
+    bool dataLoaded_ = false;
+    bool registrationInFlight_ = false;
 
     QLineEdit *registerNicknameEdit_ = nullptr;
     QLineEdit *registerEmailEdit_ = nullptr;
@@ -199,6 +207,7 @@ private:
     QWidget *statisticsPage_ = nullptr;
 
     QComboBox *problemCombo_ = nullptr;
+    QLineEdit *problemSearchEdit_ = nullptr;
     QTextEdit *problemStatement_ = nullptr;
     QButtonGroup *answerButtons_ = nullptr;
     QVector<QRadioButton *> answerOptions_;
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QStringList>
+#include <QTextStream>
+
+// Helpers shared by the command-line harnesses (NavLockStress,
+// NavOptionsBench, ...) that main() runs instead of the GUI.
+class NavCommandLine
+{
+public:
+    // One harness: the first argument that selects it and its entry point,
+    // which receives QCoreApplication::arguments().
+    struct Command {
+        const char *flag;
+        int (*run)(const QStringList &arguments);
+    };
+
+    static QTextStream &out();
+    static QTextStream &err();
+
+    // Prints "usage: <application> <flag> <arguments>" and returns EXIT_FAILURE.
+    static int usage(const char *flag, const char *arguments);
+
+private:
+    NavCommandLine() = delete;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QSqlDatabase>
+#include <QString>
+
+// Hands out one configured, long-lived connection per thread and database
+// file, shared by every component on that thread (NavigationDAO,
+// UserManager, ProblemManager). Worker-thread connections are removed when
+// the thread exits; the GUI thread keeps its connection until process exit.
+//
+// The path ":memory:" selects a scratch database private to the process but
+// shared by all its threads: a temporary file in WAL mode, so readers and
+// the write-queue worker wait on each other through busy_timeout as they
+// do on navdb.sqlite. It is deleted at exit. (A shared-cache in-memory
+// database would fail readers with SQLITE_LOCKED instead of waiting.)
+class NavConnectionManager
+{
+public:
+    // Returns an open connection, or a closed one with *error set on failure.
+    static QSqlDatabase connection(const QString &dbFilePath, QString *error = nullptr);
+
+    static QString temporaryPath();
+    static bool isTemporary(const QString &dbFilePath);
+
+private:
+    NavConnectionManager() = delete;
+};
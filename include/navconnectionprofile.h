@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QSqlDatabase>
+#include <QString>
+
+// SQLite tuning applied to every connection opened on navdb.sqlite.
+struct NavConnectionProfile
+{
+    enum class Synchronous { Off, Normal, Full };
+
+    QString     name;
+    bool        walJournal      = true;
+    Synchronous synchronous     = Synchronous::Full;
+    int         cacheSizeKiB    = 8 * 1024;
+    qint64      mmapSizeBytes   = 0;
+    bool        tempStoreMemory = false;
+    int         busyTimeoutMs   = 5000;
+
+    // WAL with a full fsync per commit; safe on any machine.
+    static NavConnectionProfile durable();
+    // WAL with NORMAL sync, large cache and mmap for lab machines.
+    static NavConnectionProfile fastLab();
+
+    // Profile used by all connections. Defaults to PER_DB_PROFILE
+    // ("durable" or "fastlab"), falling back to durable().
+    static const NavConnectionProfile &active();
+    static void setActive(const NavConnectionProfile &profile);
+
+    bool apply(QSqlDatabase &db, QString *error = nullptr) const;
+};
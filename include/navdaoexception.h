@@ -7,3 +7,11 @@ public:
     explicit NavDAOException(const QString &msg)
         : std::runtime_error(msg.toStdString()) {}
 };
+
+// Another connection held the database lock for longer than busy_timeout.
+// NavigationDAO::writeTransaction() retries these; elsewhere they surface
+// like any other NavDAOException.
+class NavDAOBusyException : public NavDAOException {
+public:
+    using NavDAOException::NavDAOException;
+};
@@ -2,21 +2,34 @@
 
 #include "navtypes.h"
 #include "navigationdao.h"
+#include "asyncnavigationdao.h"
 
+#include <QFuture>
 #include <QMap>
+#include <QSet>
 #include <QVector>
 #include <QString>
 
+#include <memory>
+
+class QObject;
+
 class Navigation
 {
 public:
     static Navigation &instance();
+    // Database used by instance() instead of the navdb.sqlite found next to
+    // the executable; NavConnectionManager::temporaryPath() for an empty
+    // scratch one. Only has an effect before the first instance() call.
+    static void setDatabasePath(const QString &path);
 
     const QMap<QString, User> &users() const { return m_users; }
     const QVector<Problem> &problems() const { return m_problems; }
 
     User *findUser(const QString &nick);
     const User *findUser(const QString &nick) const;
+    // problems() is ordered by id.
+    const Problem *findProblem(qint64 id) const;
 
     User *authenticate(const QString &nick, const QString &password);
 
@@ -26,11 +39,38 @@ public:
 
     void addSession(const QString &nickName, const Session &session);
 
-    void reload();
+    // Variants of the first load and of addUser() for the GUI thread: the
+    // queries run on asyncDao() and the cache is updated in a continuation
+    // on context, which must live on the thread that uses this object. Both
+    // resolve to an error message, empty on success.
+    QFuture<QString> loadAsync(QObject *context);
+    QFuture<QString> addUserAsync(const User &user, QObject *context);
+
+    // What reload() changed in users() and problems(). Writes made through
+    // this object since the previous reload are reported too.
+    struct ReloadResult {
+        bool          full = false;             // every user was reloaded
+        bool          problemsChanged = false;
+        QSet<QString> changedUsers;             // added, edited or with new sessions
+        QSet<QString> removedUsers;
+
+        bool isEmpty() const
+        {
+            return !full && !problemsChanged && changedUsers.isEmpty() && removedUsers.isEmpty();
+        }
+    };
+
+    // Loads everything on first use unless loadAsync() already did.
+    ReloadResult reload();
 
+    // Writes made directly through dao() share this thread's connection and
+    // are not seen by reload(); go through the methods above instead.
     NavigationDAO &dao() { return m_dao; }
     const NavigationDAO &dao() const { return m_dao; }
 
+    // Database-thread variant of dao(), started on first use.
+    AsyncNavigationDAO &asyncDao();
+
 private:
     Navigation();
     ~Navigation() = default;
@@ -38,9 +78,38 @@ private:
     Navigation(const Navigation &) = delete;
     Navigation &operator=(const Navigation &) = delete;
 
+    // What the database thread reads for loadAsync() and addUserAsync().
+    struct Snapshot {
+        QMap<QString, User> users;
+        qint64              sessionWatermark = 0;
+        QVector<Problem>    problems;
+    };
+    struct StoredUser {
+        User            user;
+        QVector<qint64> sessionRows;
+    };
+
     void loadFromDb();
+    void adoptSnapshot(Snapshot snapshot, qint64 dataVersion, const NavigationDAO::ChangeCounters &counters);
+    void adoptUser(const User &user, const QVector<qint64> &sessionRows);
+    void patchUsers(ReloadResult &result);
+    bool patchSessions(qint64 expectedRows, ReloadResult &result);
 
     NavigationDAO       m_dao;
     QMap<QString, User> m_users;
     QVector<Problem>    m_problems;
+
+    // Database state the cache above corresponds to.
+    bool                          m_loaded = false;
+    qint64                        m_dataVersion = -1;
+    NavigationDAO::ChangeCounters m_counters;
+    qint64                        m_sessionWatermark = 0;
+
+    // Local writes already applied to the cache.
+    bool          m_localWrites = false;
+    QSet<qint64>  m_localSessionRows;
+    QSet<QString> m_localChangedUsers;
+    QSet<QString> m_localRemovedUsers;
+
+    std::unique_ptr<AsyncNavigationDAO> m_asyncDao;
 };
@@ -2,6 +2,7 @@
 
 #include "navtypes.h"
 #include "navdaoexception.h"
+#include "navrowdecoder.h"
 
 #include <QSqlDatabase>
 #include <QSqlQuery>
@@ -10,29 +11,158 @@
 #include <QBuffer>
 #include <QMap>
 
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
 class NavigationDAO
 {
 public:
     explicit NavigationDAO(const QString &dbFilePath);
     ~NavigationDAO();
 
-    QMap<QString, User> loadUsers();
+    const QString &databasePath() const { return m_dbFilePath; }
+
+    // lastSessionRowId receives the highest session rowid seen by the load.
+    QMap<QString, User> loadUsers(qint64 *lastSessionRowId = nullptr);
+    // User rows only: sessions are left empty.
+    QMap<QString, User> loadUserRows();
     QVector<Problem>    loadProblems();
 
+    // Change probes used by Navigation::reload(). data_version moves when
+    // another connection commits; the counters are bumped by triggers on
+    // every row change, including the ones made through this connection.
+    qint64 dataVersion();
+
+    struct ChangeCounters {
+        qint64 users    = 0;
+        qint64 sessions = 0;
+        qint64 problems = 0;
+
+        bool operator==(const ChangeCounters &o) const
+        {
+            return users == o.users && sessions == o.sessions && problems == o.problems;
+        }
+        bool operator!=(const ChangeCounters &o) const { return !(*this == o); }
+    };
+
+    ChangeCounters changeCounters();
+
+    struct SessionRow {
+        qint64  rowId = 0;
+        QString nickName;
+        Session session;
+    };
+
+    // Sessions appended after rowId, in insertion order.
+    QVector<SessionRow> loadSessionsAfter(qint64 rowId);
+
     void saveUser(User &user);
+    // Writes only user.dirtyFields(); the caller clears them once it succeeds.
     void updateUser(const User &user);
     void deleteUser(const QString &nickName);
 
-    QVector<Session> loadSessionsFor(const QString &nickName);
-    void addSession(const QString &nickName, const Session &session);
+    QImage loadAvatar(const QString &nickName);
+    static QImage readAvatar(const QString &dbFilePath, const QString &nickName);
+    void   saveAvatar(const QString &nickName, const QImage &avatar);
 
-    void replaceAllProblems(const QVector<Problem> &problems);
+    QVector<Session> loadSessionsFor(const QString &nickName);
+    // Returns the rowid of the new session row.
+    qint64 addSession(const QString &nickName, const Session &session);
+    bool   hasSession(const QString &nickName, const QDateTime &timeStamp);
+    // Adds the missing session row of history attempts from sessions that
+    // started before startedBefore. Returns the number of sessions added.
+    int    closeAbandonedSessions(const QDateTime &startedBefore);
+
+    // Keyset position in a user's history, which is paged newest first.
+    // The default key starts at the most recent session.
+    struct SessionKey {
+        qint64 timeStampMs = std::numeric_limits<qint64>::max();
+        qint64 rowId       = std::numeric_limits<qint64>::max();
+    };
+
+    struct SessionPage {
+        QVector<Session> sessions;      // newest first
+        SessionKey       next;          // continue from here
+        bool             hasMore = false;
+    };
+
+    // Up to limit sessions older than `after` within [from, to); offset skips
+    // rows past the key. Invalid bounds leave that side open.
+    SessionPage loadSessionPage(const QString &nickName,
+                                const SessionKey &after,
+                                int limit,
+                                const QDateTime &from = {},
+                                const QDateTime &to = {},
+                                int offset = 0);
+
+    struct SessionTotals {
+        qint64 sessions = 0;
+        qint64 hits     = 0;
+        qint64 faults   = 0;
+    };
+
+    SessionTotals sessionTotals(const QString &nickName,
+                                const QDateTime &from = {},
+                                const QDateTime &to = {});
+
+    // One row of user_daily_stats; days are local calendar dates.
+    struct DailyStats {
+        QDate     day;
+        qint64    sessions        = 0;
+        qint64    hits            = 0;
+        qint64    faults          = 0;
+        qint64    attempts        = 0;
+        qint64    correctAttempts = 0;
+        QDateTime lastSession;
+    };
+
+    // Days in [from, to], oldest first; invalid bounds leave that side open.
+    QVector<DailyStats> loadDailyStats(const QString &nickName,
+                                       const QDate &from = {},
+                                       const QDate &to = {});
+
+    // Called with (rowsWritten, totalRows) as the import advances.
+    using ProgressCallback = std::function<void(qsizetype, qsizetype)>;
+
+    void replaceAllProblems(const QVector<Problem> &problems,
+                            const ProgressCallback &progress = {});
+
+    // Problem ids matching the words of query, best match first. Uses the
+    // problem_fts index when SQLite has FTS5 and a LIKE scan otherwise.
+    QVector<qint64> searchProblems(const QString &query, int limit);
+    bool hasProblemSearchIndex() const { return m_hasProblemSearch; }
+
+    struct StatementCacheStats {
+        quint64 hits   = 0;
+        quint64 misses = 0;
+    };
+
+    StatementCacheStats statementCacheStats() const { return m_statementStats; }
+
+    // Runs body between BEGIN IMMEDIATE and COMMIT, so the write lock is
+    // taken up front rather than on the first write. If another process
+    // keeps the database locked past busy_timeout, the transaction is rolled
+    // back and body runs again after a jittered backoff, a bounded number of
+    // times; body must be safe to repeat.
+    void writeTransaction(const char *where, const std::function<void()> &body);
+    // Transactions started again because the database was locked.
+    quint64 busyRetries() const { return m_busyRetries; }
 
 private:
     QString      m_dbFilePath;
-    QString      m_connectionName;
     QSqlDatabase m_db;
 
+    // Prepared statements keyed by call site; they live as long as m_db.
+    std::unordered_map<QString, std::unique_ptr<QSqlQuery>> m_statements;
+    StatementCacheStats m_statementStats;
+    quint64 m_busyRetries = 0;
+
+    bool m_hasProblemSearch = false;
+
+    QSqlQuery &cachedQuery(const char *key, const char *sql);
+
     void open();
     void close();
     void createTablesIfNeeded();
@@ -40,10 +170,43 @@ private:
     void createUserTable();
     void createSessionTable();
     void createProblemTable();
-
-    User    buildUserFromQuery(QSqlQuery &q);
-    Session buildSessionFromQuery(QSqlQuery &q);
-    Problem buildProblemFromQuery(QSqlQuery &q);
+    void createHistoryTable();
+    void createProblemSearchIndex();
+    bool problemSearchIndexStale();
+    void rebuildProblemSearchIndex();
+
+    struct Migration {
+        int         version;
+        const char *description;
+        void (NavigationDAO::*apply)();
+    };
+
+    static const QVector<Migration> &migrations();
+    int  schemaVersion();
+    void runMigrations();
+
+    void migrateSessionIndexes();
+    void migrateHistoryIndexes();
+    void migrateAvatarTable();
+    void migrateEpochTimestamps();
+    void migrateChangeCounters();
+    void migrateDailyStats();
+    void migrateAttemptIds();
+    void migrateProblemAnswers();
+    void migrateProblemIds();
+    void migrateSessionKeys();
+    void migrateDailyAttempts();
+    void migrateDropHistoryIndex();
+    void detachHistory(const QVector<Problem> &removed);
+    void createCounterTriggers(const char *table, const char *counter);
+    void backfillEpochColumn(const char *table, const char *textColumn, const char *msColumn);
+
+    void execSql(const char *where, const QString &sql);
+
+    qint64  loadAllSessionsInto(QMap<QString, User> &users);
+
+    User    buildUserFromQuery(QSqlQuery &q, const NavRowDecoder &cols);
+    Session buildSessionFromQuery(QSqlQuery &q, const NavRowDecoder &cols);
 
     QByteArray imageToPng(const QImage &img);
     QImage     imageFromPng(const QByteArray &bytes);
@@ -54,8 +217,5 @@ private:
     QString    dateTimeToDb(const QDateTime &dt) const;
     QDateTime  dateTimeFromDb(const QString &s) const;
 
-    QString    boolToDb(bool v) const;
-    bool       boolFromDb(const QString &s) const;
-
     [[noreturn]] void throwSqlError(const QString &where, const QSqlError &err) const;
 };
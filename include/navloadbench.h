@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QStringList>
+
+// Command-line benchmark for the start-up user load:
+//
+//   ProyectoPER --bench-users [users...]
+//
+// generates, for each user count (default 100 1000 10000), a scratch
+// database of synthetic users with 50 sessions each, then loads it once
+// through NavigationDAO::loadUsers() and once the old way, one
+// loadSessionsFor() per user. Prints the time and the number of statements
+// NavQueryStats saw for each: the first stays at two whatever the count.
+class NavLoadBench
+{
+public:
+    // First argument that selects the benchmark instead of the GUI.
+    static constexpr char kFlag[] = "--bench-users";
+
+    static int run(const QStringList &arguments);
+
+private:
+    NavLoadBench() = delete;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QStringList>
+
+// Command-line harness for several instances sharing one navdb.sqlite:
+//
+//   ProyectoPER --stress <processes> <sessions> <database>
+//
+// starts <processes> copies of the executable, each saving <sessions>
+// sessions through its own SessionWriteQueue (journal, then
+// NavigationDAO::writeTransaction() on the database thread), and prints the
+// throughput and the failure and retry counts. Run it on a copy of the
+// database; the sessions belong to throwaway stress_<n> users.
+class NavLockStress
+{
+public:
+    // First argument that selects the harness instead of the GUI; runParent()
+    // starts each child process with kChildFlag.
+    static constexpr char kFlag[]      = "--stress";
+    static constexpr char kChildFlag[] = "--stress-child";
+
+    static int run(const QStringList &arguments);
+
+private:
+    NavLockStress() = delete;
+
+    static int runParent(int processes, int sessions, const QString &dbFilePath);
+    static int runChild(int index, int sessions, const QString &dbFilePath);
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QStringList>
+
+// Command-line benchmark for the question_history options encodings:
+//
+//   ProyectoPER --bench-options [attempts]
+//
+// writes [attempts] (default 1000000) four-answer option lists to a
+// scratch database once as JSON and once as CBOR, then reads them back
+// and decodes them through NavOptionsCodec, printing the stored size and
+// the encode, insert and load times of each.
+class NavOptionsBench
+{
+public:
+    // First argument that selects the benchmark instead of the GUI.
+    static constexpr char kFlag[] = "--bench-options";
+
+    static int run(const QStringList &arguments);
+
+private:
+    NavOptionsBench() = delete;
+};
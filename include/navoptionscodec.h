@@ -0,0 +1,26 @@
+#pragma once
+
+#include "navtypes.h"
+
+#include <QByteArray>
+#include <QVector>
+
+// Encoding of the answer options kept in question_history.optionsJson.
+//
+// New rows hold a CBOR array of [text, correct] pairs behind the CBOR
+// self-describe tag (bytes d9 d9 f7), which no JSON document starts with.
+// Rows written before hold a JSON array of {"text", "correct"} objects;
+// decode() reads both.
+class NavOptionsCodec
+{
+public:
+    static QByteArray encode(const QVector<Answer> &answers);
+    // The previous JSON form, to compare against rows that still use it.
+    static QByteArray encodeJson(const QVector<Answer> &answers);
+
+    static QVector<Answer> decode(const QByteArray &bytes);
+    static bool isCbor(const QByteArray &bytes);
+
+private:
+    NavOptionsCodec() = delete;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+class QSqlQuery;
+
+// Process-wide counters for the SQL issued by the data layer, keyed by call
+// site. Statements slower than the threshold are logged with their SQL.
+// PER_SLOW_QUERY_MS sets the threshold (default 100, negative disables);
+// PER_QUERY_STATS=1 prints a report to stderr at exit, any other value is
+// taken as the file to write it to.
+class NavQueryStats
+{
+public:
+    struct Entry {
+        QString statement;
+        quint64 calls   = 0;
+        quint64 rows    = 0;   // returned, or affected for writes
+        qint64  totalNs = 0;
+        qint64  maxNs   = 0;
+    };
+
+    static NavQueryStats &instance();
+
+    // Reads the environment switches; call once, after QCoreApplication exists.
+    static void installFromEnvironment();
+
+    void record(const char *statement, const QSqlQuery &query, qint64 elapsedNs, qint64 rows);
+
+    // Entries sorted by total time, slowest first.
+    QVector<Entry> snapshot() const;
+    QString report() const;
+    void reset();
+
+    qint64 slowThresholdMs() const { return m_slowThresholdMs.load(std::memory_order_relaxed); }
+    void setSlowThresholdMs(qint64 ms) { m_slowThresholdMs.store(ms, std::memory_order_relaxed); }
+
+private:
+    NavQueryStats() = default;
+
+    mutable QMutex          m_mutex;
+    QHash<QString, Entry>   m_entries;
+    std::atomic<qint64>     m_slowThresholdMs{100};
+};
+
+// Times one statement from construction to destruction, so a SELECT's row
+// loop is included. Declare it after the query it measures.
+class NavQueryTimer
+{
+public:
+    NavQueryTimer(const char *statement, const QSqlQuery &query);
+    ~NavQueryTimer();
+
+    void addRow() { ++m_rows; }
+
+private:
+    NavQueryTimer(const NavQueryTimer &) = delete;
+    NavQueryTimer &operator=(const NavQueryTimer &) = delete;
+
+    const char      *m_statement;
+    const QSqlQuery &m_query;
+    QElapsedTimer    m_timer;
+    qint64           m_rows = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QVarLengthArray>
+#include <QVariant>
+
+#include <initializer_list>
+
+// Resolves a fixed list of column names to ordinals once per result set,
+// so row builders read values by index instead of looking names up per row.
+// Columns are addressed by their position in the list given at construction.
+class NavRowDecoder
+{
+public:
+    NavRowDecoder(const QSqlQuery &q, std::initializer_list<const char *> columns)
+    {
+        const QSqlRecord record = q.record();
+        for (const char *name : columns) {
+            m_ordinals.push_back(record.indexOf(QLatin1String(name)));
+        }
+    }
+
+    bool has(int column) const { return m_ordinals[column] >= 0; }
+
+    QVariant value(const QSqlQuery &q, int column) const
+    {
+        const int ordinal = m_ordinals[column];
+        return ordinal < 0 ? QVariant() : q.value(ordinal);
+    }
+
+private:
+    QVarLengthArray<int, 16> m_ordinals;
+};
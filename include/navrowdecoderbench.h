@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QStringList>
+
+// Command-line microbenchmark for NavRowDecoder:
+//
+//   ProyectoPER --bench-decoder [rows]
+//
+// fills a scratch database with [rows] (default 100000) session rows and
+// as many problem rows in the legacy answer1..4/val1..4 layout, then reads
+// each table three times: looking every column up by name per row, as the
+// row builders used to, through a NavRowDecoder, and by plain index as the
+// floor. Prints the time of each pass.
+class NavRowDecoderBench
+{
+public:
+    // First argument that selects the benchmark instead of the GUI.
+    static constexpr char kFlag[] = "--bench-decoder";
+
+    static int run(const QStringList &arguments);
+
+private:
+    NavRowDecoderBench() = delete;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "navigationdao.h"
+
+#include <QDateTime>
+#include <QStringList>
+
+// Fills a database with made-up users, sessions, question history and
+// problems, so the data layer can be measured without a real navdb.sqlite.
+// Combined with NavConnectionManager::temporaryPath() nothing is left on disk.
+//
+// Sessions are spread over the last Options::days days, more on weekdays
+// and mostly in the morning and evening; the attempts of a session follow
+// it tens of seconds apart and are answered right at a per-user rate.
+// History rows reference the generated problems by id, as storeAttempts()
+// writes them. The same seed and Options::end give the same dataset,
+// attempt ids included.
+//
+// From the command line:
+//
+//   ProyectoPER --generate <database|:memory:> [--users N] [--sessions N]
+//               [--attempts N] [--problems N] [--days N] [--seed N]
+//               [--bench-load]
+//
+// generates into <database> and with --bench-load then times what
+// Navigation does at start-up (loadUsers() and loadProblems()) on a new
+// NavigationDAO. The problem import is always timed on its own, so
+// --users 0 --problems 50000 measures a 50k-problem replaceAllProblems().
+class NavSyntheticDataset
+{
+public:
+    struct Options {
+        int       users              = 100;
+        int       sessionsPerUser    = 50;
+        int       attemptsPerSession = 10;
+        int       problems           = 200;
+        int       days               = 365;
+        quint32   seed               = 1;
+        QDateTime end                = QDateTime::currentDateTime();
+    };
+
+    struct Stats {
+        qint64 users     = 0;
+        qint64 sessions  = 0;
+        qint64 attempts  = 0;
+        qint64 problems  = 0;
+        qint64 importMs  = 0;   // replaceAllProblems() alone
+        qint64 elapsedMs = 0;
+    };
+
+    // Users already in dao are left alone; new ones are synth_<n>, numbered
+    // after the ones a previous run created. progress gets (users, total),
+    // importProgress what replaceAllProblems() reports for the bank.
+    static Stats generate(NavigationDAO &dao, const Options &options,
+                          const NavigationDAO::ProgressCallback &progress = {},
+                          const NavigationDAO::ProgressCallback &importProgress = {});
+
+    // First argument that selects the generator instead of the GUI.
+    static constexpr char kFlag[] = "--generate";
+
+    static int run(const QStringList &arguments);
+
+private:
+    NavSyntheticDataset() = delete;
+};
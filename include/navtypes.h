@@ -6,6 +6,11 @@
 #include <QImage>
 #include <QVector>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
 class Answer {
 public:
     Answer() = default;
@@ -45,6 +50,10 @@ public:
     Problem(const QString &text, const QVector<Answer> &answers)
         : m_text(text), m_answers(answers) {}
 
+    // problem.id, kept across imports; 0 until the problem is stored.
+    qint64 id() const { return m_id; }
+    void setId(qint64 id) { m_id = id; }
+
     const QString &text() const { return m_text; }
     void setText(const QString &t) { m_text = t; }
 
@@ -52,12 +61,66 @@ public:
     void setAnswers(const QVector<Answer> &ans) { m_answers = ans; }
 
 private:
+    qint64          m_id = 0;
     QString         m_text;
     QVector<Answer> m_answers;
 };
 
+// Avatar image decoded on first access. Copies share the decoded result,
+// so a user copied around the UI decodes its picture at most once.
+class AvatarHandle {
+public:
+    using Loader = std::function<QImage()>;
+
+    AvatarHandle() = default;
+    explicit AvatarHandle(const QImage &image)
+        : m_state(std::make_shared<State>()) {
+        m_state->image = image;
+        std::call_once(m_state->once, [] {});
+        m_state->loaded = true;
+    }
+    explicit AvatarHandle(Loader loader)
+        : m_state(std::make_shared<State>()) {
+        m_state->loader = std::move(loader);
+    }
+
+    const QImage &image() const {
+        static const QImage s_null;
+        if (!m_state)
+            return s_null;
+        std::call_once(m_state->once, [state = m_state.get()] {
+            if (state->loader)
+                state->image = state->loader();
+            state->loader = nullptr;
+            state->loaded = true;
+        });
+        return m_state->image;
+    }
+
+    bool isLoaded() const { return !m_state || m_state->loaded; }
+
+private:
+    struct State {
+        std::once_flag    once;
+        std::atomic_bool  loaded{false};
+        Loader            loader;
+        QImage            image;
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
 class User {
 public:
+    // Columns changed since the user was loaded or last saved; updateUser()
+    // writes only these.
+    enum Field : unsigned {
+        EmailField     = 1u << 0,
+        PasswordField  = 1u << 1,
+        AvatarField    = 1u << 2,
+        BirthdateField = 1u << 3,
+    };
+
     User() = default;
 
     User(const QString &nickName,
@@ -74,13 +137,24 @@ public:
     const QString &nickName() const { return m_nickName; }
     const QString &email() const { return m_email; }
     const QString &password() const { return m_password; }
-    const QImage  &avatar() const { return m_avatar; }
+    const QImage  &avatar() const { return m_avatar.image(); }
+    bool avatarLoaded() const { return m_avatar.isLoaded(); }
     const QDate   &birthdate() const { return m_birthdate; }
 
-    void setEmail(const QString &e) { m_email = e; }
-    void setPassword(const QString &p) { m_password = p; }
-    void setAvatar(const QImage &img) { m_avatar = img; }
-    void setBirthdate(const QDate &d) { m_birthdate = d; }
+    void setEmail(const QString &e) {
+        if (e != m_email) { m_email = e; m_dirty |= EmailField; }
+    }
+    void setPassword(const QString &p) {
+        if (p != m_password) { m_password = p; m_dirty |= PasswordField; }
+    }
+    void setAvatar(const QImage &img) { m_avatar = AvatarHandle(img); m_dirty |= AvatarField; }
+    void setAvatarLoader(AvatarHandle::Loader loader) { m_avatar = AvatarHandle(std::move(loader)); }
+    void setBirthdate(const QDate &d) {
+        if (d != m_birthdate) { m_birthdate = d; m_dirty |= BirthdateField; }
+    }
+
+    unsigned dirtyFields() const { return m_dirty; }
+    void clearDirtyFields() { m_dirty = 0; }
 
     const QVector<Session> &sessions() const { return m_sessions; }
     void setSessions(const QVector<Session> &s) { m_sessions = s; }
@@ -97,9 +171,10 @@ private:
     QString          m_nickName;
     QString          m_email;
     QString          m_password;
-    QImage           m_avatar;
+    AvatarHandle     m_avatar;
     QDate            m_birthdate;
     QVector<Session> m_sessions;
 
     bool             m_insertedDb = false;
+    unsigned         m_dirty      = 0;
 };
@@ -2,6 +2,8 @@
 
 #include <optional>
 
+#include <QFuture>
+#include <QHash>
 #include <QObject>
 #include <QString>
 #include <QVector>
@@ -14,6 +16,7 @@ struct AnswerOption {
 };
 
 struct ProblemEntry {
+    // problem.id, the key question_history refers to.
     int id = -1;
     QString category;
     QString text;
@@ -26,14 +29,22 @@ public:
     explicit ProblemManager(Navigation &navigation, QObject *parent = nullptr);
 
     bool load();
+    // load() with the query on the database thread; problemsChanged() is
+    // emitted from a continuation on this object's thread.
+    QFuture<void> loadAsync();
     QVector<ProblemEntry> problems() const;
     std::optional<ProblemEntry> findById(int id) const;
     std::optional<ProblemEntry> randomProblem() const;
+    // Ids of the problems whose statement or answers match query, best first.
+    QVector<int> search(const QString &query, int limit) const;
 
 signals:
     void problemsChanged();
 
 private:
+    void adoptProblems(QVector<ProblemEntry> problems);
+
     Navigation &navigation_;
     QVector<ProblemEntry> problems_;
+    QHash<int, int> indexById_;
 };
@@ -10,25 +10,35 @@
 class QTableWidget;
 class QDateEdit;
 class QLabel;
+class QPushButton;
 
 class ResultsDialog : public QDialog {
     Q_OBJECT
 public:
-    ResultsDialog(const QVector<SessionRecord> &sessions, QWidget *parent = nullptr);
+    ResultsDialog(const UserManager &userManager, const QString &nickname, QWidget *parent = nullptr);
 
 private slots:
     void updateFilter();
+    void loadMore();
 
 private:
     void setupUi();
     void populateTable();
+    void appendRows(int firstIndex);
+    void updateSummary();
     void updateAttemptDetails(int visibleRow);
 
+    const UserManager &userManager_;
+    QString nickname_;
+    SessionCursor cursor_;
     QVector<SessionRecord> sessions_;
+    // Parallel to sessions_: whether its attempts have been fetched yet.
+    QVector<bool> attemptsLoaded_;
     QTableWidget *table_ = nullptr;
     QTableWidget *attemptsTable_ = nullptr;
     QDateEdit *fromDateEdit_ = nullptr;
     QLabel *summaryLabel_ = nullptr;
     QLabel *attemptsHeaderLabel_ = nullptr;
+    QPushButton *loadMoreButton_ = nullptr;
     QVector<int> visibleSessionIndexes_;
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QFuture>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+class QLockFile;
+
+#include "navigation.h"
+#include "userrecords.h"
+
+// Write-behind queue for answered attempts and finished sessions. enqueue()
+// and enqueueAttempt() append the record to a journal file and return; a
+// coalesced flush then writes every pending record in one transaction on the
+// database thread. Records still in the journal at startup are replayed, and
+// a flush is idempotent, so a crash at any point neither loses nor duplicates
+// a session or an attempt.
+//
+// Several instances may share a database, so each one journals to its own
+// <journalBase>.<pid>.journal and holds <journalBase>.<pid>.lock while it
+// runs. At startup an instance also takes over the journals whose lock is
+// free, i.e. whose owner exited or crashed, and leaves the others alone.
+class SessionWriteQueue : public QObject {
+    Q_OBJECT
+public:
+    SessionWriteQueue(Navigation &navigation, QString journalBase, QObject *parent = nullptr);
+    ~SessionWriteQueue() override;
+
+    // <databasePath>.sessions, or a per-process name in the temporary
+    // directory for NavConnectionManager::temporaryPath().
+    static QString journalBaseFor(const QString &databasePath);
+
+    bool enqueue(const QString &nickname, const SessionRecord &session, QString &errorMessage);
+    // attempt must carry its id; it is stored without touching the session row.
+    bool enqueueAttempt(const QString &nickname,
+                        const QDateTime &sessionTimestamp,
+                        const QuestionAttempt &attempt,
+                        QString &errorMessage);
+
+    // Journaled sessions of nickname that are not known to be committed,
+    // with the attempts queued for them.
+    QVector<SessionRecord> pendingFor(const QString &nickname) const;
+    bool isEmpty() const { return pending_.isEmpty(); }
+
+    // Writes everything pending and waits for it.
+    bool flush(QString &errorMessage);
+
+signals:
+    void flushFailed(const QString &errorMessage);
+
+private:
+    struct Entry {
+        quint64 seq = 0;
+        QString nickname;
+        SessionRecord session;
+        bool attemptOnly = false;   // session holds one attempt and no row to write
+    };
+
+    bool append(Entry entry, QString &errorMessage);
+
+    void scheduleFlush();
+    void startFlush();
+    QFuture<QString> submit(const QVector<Entry> &batch);
+    void completeUpTo(quint64 seq);
+
+    void replayJournal();
+    void adoptOrphanedJournals();
+    QVector<Entry> readJournal(const QString &path) const;
+    bool appendToJournal(const Entry &entry, QString &errorMessage);
+    bool rewriteJournal(QString &errorMessage);
+
+    static QByteArray encodeEntry(const Entry &entry);
+    static bool decodeEntry(const QByteArray &line, Entry &entry);
+    static QString writeBatch(NavigationDAO &dao, const QVector<Entry> &batch);
+
+    Navigation &navigation_;
+    QString journalBase_;
+    QString journalPath_;
+    std::unique_ptr<QLockFile> journalLock_;
+    QVector<Entry> pending_;
+    quint64 nextSeq_ = 1;
+    bool flushScheduled_ = false;
+    QFuture<QString> inFlight_;
+};
@@ -4,43 +4,25 @@
 
 #include <QDate>
 #include <QDateTime>
+#include <QFuture>
+#include <QHash>
 #include <QImage>
+#include <QSqlDatabase>
 #include <QString>
 #include <QVector>
 
+#include "avatarstore.h"
+#include "userrecords.h"
 #include "navigation.h"
+#include "sessionwritequeue.h"
 
-struct AttemptOption {
-    QString text;
-    bool correct = false;
-};
-
-struct QuestionAttempt {
-    QDateTime timestamp;
-    int problemId = -1;
-    QString question;
-    QString selectedAnswer;
-    QString correctAnswer;
-    bool correct = false;
-    QVector<AttemptOption> options;
-    int selectedIndex = -1;
-};
-
-struct SessionRecord {
-    QDateTime timestamp;
-    int hits = 0;
-    int faults = 0;
-    QVector<QuestionAttempt> attempts;
-};
-
-struct UserRecord {
+// Position in a user's session history; fetchSessions() walks it newest first.
+struct SessionCursor {
     QString nickname;
-    QString email;
-    QString passwordHash;
-    QString salt;
-    QDate birthdate;
-    QString avatarPath;
-    QVector<SessionRecord> sessions;
+    QDateTime from;
+    QDateTime to;
+    NavigationDAO::SessionKey position;
+    bool atEnd = false;
 };
 
 class UserManager {
@@ -55,6 +37,16 @@ public:
                       const QString &avatarSource,
                       QString &errorMessage);
 
+    // load() and registerUser() with the reads and the insert on the database
+    // thread, continued on context. Resolve to an error message, empty on success.
+    QFuture<QString> loadAsync(QObject *context);
+    QFuture<QString> registerUserAsync(const QString &nickname,
+                                       const QString &email,
+                                       const QString &password,
+                                       const QDate &birthdate,
+                                       const QString &avatarSource,
+                                       QObject *context);
+
     std::optional<UserRecord> authenticate(const QString &nickname,
                                            const QString &password,
                                            QString &errorMessage) const;
@@ -65,34 +57,85 @@ public:
                     const QDate &birthdate,
                     const QString &avatarSource,
                     QString &errorMessage);
+    // Queues one answered attempt of the running session, giving it an id.
+    bool recordAttempt(const QString &nickname,
+                       const QDateTime &sessionTimestamp,
+                       QuestionAttempt &attempt,
+                       QString &errorMessage);
+    // Queues the finished session; attempts already recorded are not written again.
     bool appendSession(const QString &nickname, const SessionRecord &session, QString &errorMessage);
+    // Blocks until every queued session is in the database.
+    bool flushPendingSessions(QString &errorMessage);
+
+    SessionCursor openSessionCursor(const QString &nickname,
+                                    const QDateTime &from = {},
+                                    const QDateTime &to = {}) const;
+    // Appends up to limit sessions to out and advances the cursor. The records
+    // come without attempts; sessionAttempts() loads them for one session.
+    bool fetchSessions(SessionCursor &cursor, int limit, QVector<SessionRecord> &out, QString &errorMessage) const;
+    bool sessionAttempts(const QString &nickname,
+                         const QDateTime &sessionTimestamp,
+                         QVector<QuestionAttempt> &out,
+                         QString &errorMessage) const;
+    std::optional<NavigationDAO::SessionTotals> sessionTotals(const SessionCursor &cursor, QString &errorMessage) const;
+
+    // Per-day totals from user_daily_stats, oldest first.
+    bool dailyStats(const QString &nickname,
+                    const QDate &from,
+                    const QDate &to,
+                    QVector<NavigationDAO::DailyStats> &out,
+                    QString &errorMessage) const;
 
     std::optional<UserRecord> getUser(const QString &nickname) const;
+    // Records are returned without avatarPath; use getUser() for a displayable user.
     QVector<UserRecord> allUsers() const;
 
+    // Inserts the attempts of a session on db, inside the caller's transaction.
+    // Attempts whose id is already stored are left as they are. An attempt on
+    // a problem that is still in the bank unchanged stores only its problemId
+    // and answer indexes.
+    static bool storeAttempts(QSqlDatabase &db,
+                              const QString &nickname,
+                              const QDateTime &sessionTimestamp,
+                              const QVector<QuestionAttempt> &attempts,
+                              QString &errorMessage);
+
     QString resolvedAvatarPath(const QString &storedPath) const;
+    // Prebuilt size x size thumbnail when the avatar has one, else resolvedAvatarPath().
+    QString avatarThumbnailPath(const QString &storedPath, int size) const;
 
 private:
     QString hashPassword(const QString &password, const QString &salt) const;
     QString generateSalt() const;
-    QString ensureAvatarStored(const QString &nickname, const QString &sourcePath, QString &errorMessage) const;
+    QString ensureAvatarStored(const QString &sourcePath, QString &errorMessage) const;
     int findIndex(const QString &nickname) const;
+    // The checks and avatar handling registerUser() does before the insert.
+    std::optional<User> prepareNewUser(const QString &nickname,
+                                       const QString &email,
+                                       const QString &password,
+                                       const QDate &birthdate,
+                                       const QString &avatarSource,
+                                       QString &errorMessage) const;
 
     QString encodePasswordPayload(const QString &salt, const QString &hash) const;
     void decodePasswordPayload(const QString &payload, QString &saltOut, QString &hashOut) const;
     UserRecord makeRecordFromNavUser(const User &navUser) const;
     SessionRecord makeRecordFromNavSession(const QString &nickname, const Session &navSession) const;
-    QString persistAvatarImage(const QString &nickname, const QImage &image) const;
+    UserRecord withAvatar(UserRecord record) const;
+    QString persistAvatarImage(const QImage &image) const;
     QImage loadAvatarImage(const QString &path) const;
-    QString resolveDatabasePath() const;
     bool ensureHistoryStorage(QString &errorMessage) const;
     QVector<QuestionAttempt> loadSessionAttempts(const QString &nickname, const QDateTime &sessionTimestamp) const;
-    bool storeSessionAttempts(const QString &nickname, const SessionRecord &session, QString &errorMessage) const;
-    QString historyConnectionName() const;
+    // Fills the text of an attempt stored by reference from the problem bank.
+    void resolveStoredProblem(QuestionAttempt &attempt, int correctIndex) const;
 
     Navigation &navigation_;
     QString avatarsDirectory_;
+    AvatarStore avatarStore_;
+    SessionWriteQueue writeQueue_;
     QString databasePath_;
     mutable bool historyStorageReady_ = false;
+    bool loaded_ = false;
+    mutable QHash<QString, QString> avatarPaths_;
     QVector<UserRecord> users_;
 };
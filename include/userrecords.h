@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QDate>
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+
+struct AttemptOption {
+    QString text;
+    bool correct = false;
+};
+
+struct QuestionAttempt {
+    // Stable key of the stored row; empty until the attempt is first recorded.
+    QString id;
+    QDateTime timestamp;
+    int problemId = -1;
+    QString question;
+    QString selectedAnswer;
+    QString correctAnswer;
+    bool correct = false;
+    QVector<AttemptOption> options;
+    int selectedIndex = -1;
+};
+
+struct SessionRecord {
+    QDateTime timestamp;
+    int hits = 0;
+    int faults = 0;
+    QVector<QuestionAttempt> attempts;
+};
+
+struct UserRecord {
+    QString nickname;
+    QString email;
+    QString passwordHash;
+    QString salt;
+    QDate birthdate;
+    QString avatarPath;
+    QVector<SessionRecord> sessions;
+};
@@ -0,0 +1,74 @@
+#include "asyncnavigationdao.h"
+
+class AsyncNavigationDAO::Worker : public QObject
+{
+public:
+    explicit Worker(std::unique_ptr<NavigationDAO> &dao)
+        : m_dao(dao) {}
+
+    // Runs on the database thread when it finishes, so the connection is
+    // removed from the thread that opened it.
+    ~Worker() override { m_dao.reset(); }
+
+private:
+    std::unique_ptr<NavigationDAO> &m_dao;
+};
+
+AsyncNavigationDAO::AsyncNavigationDAO(const QString &dbFilePath)
+    : m_dbFilePath(dbFilePath)
+{
+    m_thread.setObjectName(QStringLiteral("navdb-worker"));
+
+    auto *worker = new Worker(m_dao);
+    worker->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, worker, &QObject::deleteLater);
+    m_worker = worker;
+
+    m_thread.start();
+}
+
+AsyncNavigationDAO::~AsyncNavigationDAO()
+{
+    waitForIdle();
+    m_thread.quit();
+    m_thread.wait();
+}
+
+NavigationDAO &AsyncNavigationDAO::workerDao()
+{
+    if (!m_dao) {
+        m_dao = std::make_unique<NavigationDAO>(m_dbFilePath);
+    }
+    return *m_dao;
+}
+
+void AsyncNavigationDAO::waitForIdle()
+{
+    if (QThread::currentThread() == &m_thread)
+        return;
+
+    QMetaObject::invokeMethod(m_worker, [] {}, Qt::BlockingQueuedConnection);
+}
+
+QFuture<QMap<QString, User>> AsyncNavigationDAO::loadUsers()
+{
+    return run([](NavigationDAO &dao) { return dao.loadUsers(); });
+}
+
+QFuture<QVector<Problem>> AsyncNavigationDAO::loadProblems()
+{
+    return run([](NavigationDAO &dao) { return dao.loadProblems(); });
+}
+
+QFuture<void> AsyncNavigationDAO::addSession(const QString &nickName, const Session &session)
+{
+    return run([nickName, session](NavigationDAO &dao) { dao.addSession(nickName, session); });
+}
+
+QFuture<User> AsyncNavigationDAO::saveUser(const User &user)
+{
+    return run([user](NavigationDAO &dao) mutable {
+        dao.saveUser(user);
+        return user;
+    });
+}
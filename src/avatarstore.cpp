@@ -0,0 +1,94 @@
+#include "avatarstore.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QSaveFile>
+
+#include <utility>
+
+namespace {
+QString thumbnailName(const QString &hash, int size) {
+	return hash + QLatin1Char('_') + QString::number(size) + QLatin1String(".png");
+}
+
+QImage squareThumbnail(const QImage &image, int size) {
+	const QImage scaled = image.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+	const int x = (scaled.width() - size) / 2;
+	const int y = (scaled.height() - size) / 2;
+	return scaled.copy(x, y, size, size);
+}
+} // namespace
+
+AvatarStore::AvatarStore(QString directory)
+	: directory_(std::move(directory)) {}
+
+QString AvatarStore::store(const QImage &image, QString &errorMessage) const {
+	if (image.isNull()) {
+		errorMessage = QObject::tr("No se pudo leer la imagen seleccionada.");
+		return {};
+	}
+	if (directory_.isEmpty() || !QDir().mkpath(directory_)) {
+		errorMessage = QObject::tr("No se pudo acceder a la carpeta de avatares.");
+		return {};
+	}
+
+	const QString hash = contentHash(image);
+	const QString fileName = hash + QLatin1String(".png");
+
+	// Same pixels, same name: an existing file is already this image.
+	if (!QFileInfo::exists(absolutePath(fileName)) && !writePng(image, fileName)) {
+		errorMessage = QObject::tr("No se pudo guardar la imagen seleccionada.");
+		return {};
+	}
+
+	for (const int size : kThumbnailSizes) {
+		const QString name = thumbnailName(hash, size);
+		if (!QFileInfo::exists(absolutePath(name))) {
+			writePng(squareThumbnail(image, size), name);
+		}
+	}
+
+	return fileName;
+}
+
+QString AvatarStore::thumbnailPath(const QString &storedName, int size) const {
+	if (directory_.isEmpty() || !storedName.endsWith(QLatin1String(".png"))) {
+		return {};
+	}
+
+	const QString hash = storedName.chopped(4);
+	const QString path = absolutePath(thumbnailName(hash, size));
+	return QFileInfo::exists(path) ? path : QString();
+}
+
+QString AvatarStore::contentHash(const QImage &image) {
+	// Hash decoded pixels rather than file bytes, so the same picture saved
+	// by different encoders is stored once. Rows are hashed without padding.
+	const QImage pixels = image.convertToFormat(QImage::Format_ARGB32);
+	const qsizetype rowBytes = qsizetype(pixels.width()) * 4;
+
+	QCryptographicHash hash(QCryptographicHash::Sha256);
+	const qint32 dims[] = {pixels.width(), pixels.height()};
+	hash.addData(QByteArrayView(reinterpret_cast<const char *>(dims), sizeof(dims)));
+	for (int y = 0; y < pixels.height(); ++y) {
+		hash.addData(QByteArrayView(reinterpret_cast<const char *>(pixels.constScanLine(y)), rowBytes));
+	}
+	return QString::fromLatin1(hash.result().toHex());
+}
+
+QString AvatarStore::absolutePath(const QString &fileName) const {
+	return directory_ + QLatin1Char('/') + fileName;
+}
+
+bool AvatarStore::writePng(const QImage &image, const QString &fileName) const {
+	// Written through QSaveFile so a half-written file never takes the name.
+	QSaveFile file(absolutePath(fileName));
+	if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit()) {
+		return false;
+	}
+	QFile::setPermissions(absolutePath(fileName), QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther | QFile::WriteUser);
+	return true;
+}
@@ -2,6 +2,13 @@
 #include "problemmanager.h"
 #include "usermanager.h"
 #include "navigation.h"
+#include "navcommandline.h"
+#include "navloadbench.h"
+#include "navlockstress.h"
+#include "navoptionsbench.h"
+#include "navrowdecoderbench.h"
+#include "navsyntheticdataset.h"
+#include "navquerystats.h"
 
 #include <QApplication>
 #include <QCoreApplication>
@@ -9,11 +16,21 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QIODevice>
-#include <QMessageBox>
 #include <QStringList>
 
 #include <cstdlib>
 
+namespace {
+const NavCommandLine::Command kCommands[] = {
+    {NavLockStress::kFlag, &NavLockStress::run},
+    {NavLockStress::kChildFlag, &NavLockStress::run},
+    {NavOptionsBench::kFlag, &NavOptionsBench::run},
+    {NavRowDecoderBench::kFlag, &NavRowDecoderBench::run},
+    {NavLoadBench::kFlag, &NavLoadBench::run},
+    {NavSyntheticDataset::kFlag, &NavSyntheticDataset::run},
+};
+}
+
 QString dataPath(const QString &relative) {
     const QString appDir = QCoreApplication::applicationDirPath();
     QStringList searchRoots;
@@ -38,25 +55,37 @@ QString dataPath(const QString &relative) {
 }
 
 int main(int argc, char *argv[]) {
+    // Headless harnesses selected by the first argument instead of the GUI.
+    if (argc > 1) {
+        for (const NavCommandLine::Command &command : kCommands) {
+            if (qstrcmp(argv[1], command.flag) == 0) {
+                QCoreApplication app(argc, argv);
+                return command.run(app.arguments());
+            }
+        }
+    }
+
     QApplication::setAttribute(Qt::AA_DontShowIconsInMenus, false);
     QApplication app(argc, argv);
     QCoreApplication::setOrganizationName(QStringLiteral("UPV"));
     QCoreApplication::setApplicationName(QStringLiteral("Proyecto PER"));
+    NavQueryStats::installFromEnvironment();
+
+    // --database <file|:memory:> runs the GUI on another database, e.g. one
+    // made with --generate, instead of the navdb.sqlite next to the executable.
+    const QStringList arguments = app.arguments();
+    const qsizetype databaseArg = arguments.indexOf(QStringLiteral("--database"));
+    if (databaseArg > 0 && databaseArg + 1 < arguments.size()) {
+        Navigation::setDatabasePath(arguments.at(databaseArg + 1));
+    }
 
     const QString avatarsDir = dataPath(QStringLiteral("data/avatars"));
     Navigation &navigation = Navigation::instance();
 
+    // Users and problems are loaded on the database thread once the window
+    // is up; see MainWindow::startDataLoad().
     UserManager userManager(navigation, avatarsDir);
-    if (!userManager.load()) {
-        QMessageBox::critical(nullptr, QObject::tr("Error"), QObject::tr("No se pudo cargar la información de usuarios."));
-        return EXIT_FAILURE;
-    }
-
     ProblemManager problemManager(navigation);
-    if (!problemManager.load()) {
-        QMessageBox::critical(nullptr, QObject::tr("Error"), QObject::tr("No se pudieron cargar los problemas disponibles."));
-        return EXIT_FAILURE;
-    }
 
     MainWindow window(userManager, problemManager);
     window.show();
@@ -18,6 +18,7 @@
 #include <QFormLayout>
 #include <QFrame>
 #include <QGridLayout>
+#include <QHash>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QInputDialog>
@@ -57,6 +58,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <exception>
 #include <QtGlobal>
 
 namespace {
@@ -72,6 +75,7 @@ constexpr auto kIncorrectAnswerStyle =
     "color: #b00020; font-weight: 600; background-color: rgba(248,113,113,0.18); border-radius: 10px; padding: 6px 10px;";
 constexpr int kMaxStatsChartPoints = 12;
 constexpr int kMaxStatsTableRows = 8;
+constexpr int kMaxProblemSearchResults = 50;
 constexpr int kNavigationButtonSize = 46;
 }
 
@@ -308,10 +312,72 @@ MainWindow::MainWindow(UserManager &userManager,
     if (toolStrip_) {
         toolStrip_->setVisible(false);
     }
+
+    startDataLoad();
+}
+
+void MainWindow::startDataLoad() {
+    // Both loads run on the database thread, in this order; the window is
+    // already up meanwhile.
+    QFuture<QString> users = userManager_.loadAsync(this);
+    QFuture<void> problems = problemManager_.loadAsync();
+
+    if (guestLoginButton_) {
+        guestLoginButton_->setEnabled(false);
+    }
+    if (loginFeedbackLabel_) {
+        loginFeedbackLabel_->setStyleSheet(QString());
+        loginFeedbackLabel_->setText(tr("Cargando usuarios y problemas…"));
+        loginFeedbackLabel_->setVisible(true);
+    }
+
+    // Both continuations can throw (a reload() falling back to the database),
+    // so each has an onFailed that ends the application as an error does.
+    users
+        .then(this, [this, problems](const QString &error) mutable {
+            if (!error.isEmpty()) {
+                failDataLoad(tr("No se pudo cargar la información de usuarios.\n%1").arg(error));
+                return;
+            }
+            problems.then(this, [this]() { finishDataLoad(); })
+                .onFailed(this, [this](const std::exception &ex) {
+                    failDataLoad(tr("No se pudieron cargar los problemas disponibles.\n%1")
+                                     .arg(QString::fromUtf8(ex.what())));
+                });
+        })
+        .onFailed(this, [this](const std::exception &ex) {
+            failDataLoad(tr("No se pudo cargar la información de usuarios.\n%1").arg(QString::fromUtf8(ex.what())));
+        });
+}
+
+void MainWindow::failDataLoad(const QString &message) {
+    QMessageBox::critical(this, tr("Error"), message);
+    QCoreApplication::exit(EXIT_FAILURE);
+}
+
+void MainWindow::finishDataLoad() {
+    dataLoaded_ = true;
+    if (guestLoginButton_) {
+        guestLoginButton_->setEnabled(true);
+    }
+    if (loginFeedbackLabel_) {
+        loginFeedbackLabel_->clear();
+        loginFeedbackLabel_->setVisible(false);
+    }
+    validateLoginForm();
+    validateRegisterForm();
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
     recordSessionIfNeeded();
+
+    // Sessions are written behind; make sure they reach the database before exit.
+    QString error;
+    if (!userManager_.flushPendingSessions(error)) {
+        QMessageBox::warning(this,
+                             tr("Guardar sesión"),
+                             tr("La sesión se guardará al volver a abrir la aplicación.\n%1").arg(error));
+    }
     QMainWindow::closeEvent(event);
 }
 
@@ -670,6 +736,9 @@ void MainWindow::setQuestionPanelMode(QuestionPanelMode mode, bool syncHomeButto
     if (problemCombo_) {
         problemCombo_->setVisible(practice);
     }
+    if (problemSearchEdit_) {
+        problemSearchEdit_->setVisible(practice);
+    }
     if (randomButton_) {
         randomButton_->setVisible(practice);
     }
@@ -835,29 +904,31 @@ void MainWindow::updateStatisticsPanel() {
     };
 
     QVector<SessionStatsRow> rows;
-    rows.reserve(currentUser_ ? currentUser_->sessions.size() + 1 : 1);
+    rows.reserve(kMaxStatsChartPoints + 1);
 
     if (hasAttempts(currentSession_)) {
         rows.push_back(computeRow(currentSession_, true));
     }
 
+    // Stored sessions come pre-aggregated per day from user_daily_stats.
     QMap<QDate, SessionStatsRow> aggregatedByDate;
     if (currentUser_) {
-        for (const auto &session : currentUser_->sessions) {
-            if (!hasAttempts(session)) {
-                continue;
-            }
-            SessionStatsRow row = computeRow(session, false);
-            const QDate day = row.timestamp.date();
-            auto it = aggregatedByDate.find(day);
-            if (it == aggregatedByDate.end()) {
-                aggregatedByDate.insert(day, row);
-            } else {
-                it->correct += row.correct;
-                it->incorrect += row.incorrect;
-                if (row.timestamp > it->timestamp) {
-                    it->timestamp = row.timestamp;
+        QVector<NavigationDAO::DailyStats> days;
+        QString errorMessage;
+        if (userManager_.dailyStats(currentUser_->nickname, {}, {}, days, errorMessage)) {
+            for (const auto &day : days) {
+                SessionStatsRow row;
+                row.timestamp = day.lastSession.isValid() ? day.lastSession : day.day.startOfDay();
+                row.correct = static_cast<int>(day.hits);
+                row.incorrect = static_cast<int>(day.faults);
+                if (row.correct == 0 && row.incorrect == 0) {
+                    row.correct = static_cast<int>(day.correctAttempts);
+                    row.incorrect = static_cast<int>(day.attempts - day.correctAttempts);
+                }
+                if (row.correct == 0 && row.incorrect == 0) {
+                    continue;
                 }
+                aggregatedByDate.insert(day.day, row);
             }
         }
     }
@@ -1094,7 +1165,8 @@ void MainWindow::updateHistoryDisplay() {
         selectedIndex = !options.isEmpty() ? 0 : -1;
     }
 
-    const int optionCount = qMin(options.size(), answerOptions_.size());
+    ensureAnswerOptions(int(options.size()));
+    const int optionCount = int(options.size());
     for (int i = 0; i < answerOptions_.size(); ++i) {
         auto *option = answerOptions_.at(i);
         if (i < optionCount) {
@@ -1321,6 +1393,12 @@ void MainWindow::submitAnswer() {
         if (attempt.correctAnswer.isEmpty()) {
             attempt.correctAnswer = button->text();
         }
+
+        // Stored as it happens; on failure it is saved with the session instead.
+        if (!guestSessionActive_) {
+            QString error;
+            userManager_.recordAttempt(currentUser_->nickname, currentSession_.timestamp, attempt, error);
+        }
         currentSession_.attempts.push_back(std::move(attempt));
     }
     updateSessionLabels();
@@ -1450,7 +1528,7 @@ void MainWindow::attemptLogin() {
     const QString username = loginUserEdit_->text().trimmed();
     const QString password = loginPasswordEdit_->text();
 
-    if (username.isEmpty() || password.isEmpty()) {
+    if (!dataLoaded_ || username.isEmpty() || password.isEmpty()) {
         return;
     }
 
@@ -1495,8 +1573,8 @@ void MainWindow::validateLoginForm() {
     }
 
     const bool ready = !loginUserEdit_->text().trimmed().isEmpty() && !loginPasswordEdit_->text().isEmpty();
-    loginButton_->setEnabled(ready);
-    if (!ready) {
+    loginButton_->setEnabled(ready && dataLoaded_);
+    if (!ready && dataLoaded_) {
         if (loginFeedbackLabel_) {
             loginFeedbackLabel_->clear();
             loginFeedbackLabel_->setVisible(false);
@@ -1634,6 +1712,7 @@ void MainWindow::setupUi() {
     problemBody_ = ui_->problemBody;
     navigationRow_ = ui_->navigationRow;
     problemCombo_ = ui_->problemCombo;
+    problemSearchEdit_ = ui_->problemSearchEdit;
     randomButton_ = ui_->randomButton;
     historyControlsRow_ = ui_->historyControlsRow;
     historyControlsRow_->setVisible(false);
@@ -1662,7 +1741,8 @@ void MainWindow::setupUi() {
     nextProblemButton_->setIconSize(QSize(28, 28));
     submitButton_ = ui_->submitButton;
 
-    // Answer options
+    // Answer options: the four in the form are the first ones; problems with
+    // more answers get extra buttons from ensureAnswerOptions().
     answerButtons_ = new QButtonGroup(this);
     answerButtons_->setExclusive(true);
     answerOptions_.clear();
@@ -1763,6 +1843,7 @@ void MainWindow::setupUi() {
     connect(profileAction_, &QAction::triggered, this, &MainWindow::showProfileDialog);
     connect(logoutAction_, &QAction::triggered, this, &MainWindow::logout);
     connect(problemCombo_, &QComboBox::currentIndexChanged, this, &MainWindow::loadProblemFromSelection);
+    connect(problemSearchEdit_, &QLineEdit::textChanged, this, [this]() { populateProblems(); });
     connect(randomButton_, &QPushButton::clicked, this, &MainWindow::loadRandomProblem);
     connect(historySessionCombo_, qOverload<int>(&QComboBox::currentIndexChanged), this, &MainWindow::handleHistorySessionSelectionChanged);
     connect(prevProblemButton_, &QPushButton::clicked, this, &MainWindow::goToPreviousProblem);
@@ -1857,7 +1938,7 @@ void MainWindow::validateRegisterForm() {
 
     QString error;
     const bool valid = validateRegisterInputs(error);
-    registerSubmitButton_->setEnabled(valid);
+    registerSubmitButton_->setEnabled(valid && dataLoaded_ && !registrationInFlight_);
     if (registerFeedbackLabel_) {
         if (error.isEmpty()) {
             registerFeedbackLabel_->clear();
@@ -1872,6 +1953,9 @@ void MainWindow::validateRegisterForm() {
 }
 
 void MainWindow::handleRegisterSubmit() {
+    if (!dataLoaded_ || registrationInFlight_) {
+        return;
+    }
     if (!registerNicknameEdit_ || !registerEmailEdit_ || !registerPasswordEdit_ ||
         !registerConfirmPasswordEdit_ || !registerBirthdateEdit_) {
         return;
@@ -1892,40 +1976,49 @@ void MainWindow::handleRegisterSubmit() {
     const QString password = registerPasswordEdit_->text();
     const QDate birthdate = registerBirthdateEdit_->date();
 
-    QString error;
-    if (!userManager_.registerUser(nickname, email, password, birthdate, registerAvatarPath_, error)) {
-        if (registerFeedbackLabel_) {
-            registerFeedbackLabel_->setText(error);
-            registerFeedbackLabel_->setStyleSheet(QStringLiteral("color: #b00020;"));
-            registerFeedbackLabel_->setVisible(true);
-        }
-        return;
+    registrationInFlight_ = true;
+    if (registerSubmitButton_) {
+        registerSubmitButton_->setEnabled(false);
     }
 
-    if (registerFeedbackLabel_) {
-        registerFeedbackLabel_->clear();
-        registerFeedbackLabel_->setVisible(false);
-        registerFeedbackLabel_->setStyleSheet(QString());
-    }
+    userManager_.registerUserAsync(nickname, email, password, birthdate, registerAvatarPath_, this)
+        .then(this, [this, nickname](const QString &error) {
+            registrationInFlight_ = false;
+            if (!error.isEmpty()) {
+                if (registerFeedbackLabel_) {
+                    registerFeedbackLabel_->setText(error);
+                    registerFeedbackLabel_->setStyleSheet(QStringLiteral("color: #b00020;"));
+                    registerFeedbackLabel_->setVisible(true);
+                }
+                validateRegisterForm();
+                return;
+            }
 
-    resetRegisterForm();
-    showLoginForm();
+            if (registerFeedbackLabel_) {
+                registerFeedbackLabel_->clear();
+                registerFeedbackLabel_->setVisible(false);
+                registerFeedbackLabel_->setStyleSheet(QString());
+            }
 
-    if (loginUserEdit_) {
-        loginUserEdit_->setText(nickname);
-    }
-    if (loginPasswordEdit_) {
-        loginPasswordEdit_->clear();
-        loginPasswordEdit_->setFocus();
-    }
-    if (loginButton_) {
-        loginButton_->setEnabled(false);
-    }
-    if (loginFeedbackLabel_) {
-        loginFeedbackLabel_->setStyleSheet(QStringLiteral("color: #1f7a4d;"));
-        loginFeedbackLabel_->setText(tr("Cuenta creada. Inicia sesión con tus credenciales."));
-        loginFeedbackLabel_->setVisible(true);
-    }
+            resetRegisterForm();
+            showLoginForm();
+
+            if (loginUserEdit_) {
+                loginUserEdit_->setText(nickname);
+            }
+            if (loginPasswordEdit_) {
+                loginPasswordEdit_->clear();
+                loginPasswordEdit_->setFocus();
+            }
+            if (loginButton_) {
+                loginButton_->setEnabled(false);
+            }
+            if (loginFeedbackLabel_) {
+                loginFeedbackLabel_->setStyleSheet(QStringLiteral("color: #1f7a4d;"));
+                loginFeedbackLabel_->setText(tr("Cuenta creada. Inicia sesión con tus credenciales."));
+                loginFeedbackLabel_->setVisible(true);
+            }
+        });
 }
 
 void MainWindow::resetRegisterForm() {
@@ -2225,8 +2318,26 @@ void MainWindow::populateProblems() {
     problemCombo_->clear();
 
     const auto problems = problemManager_.problems();
-    for (const auto &problem : problems) {
-        problemCombo_->addItem(QStringLiteral("#%1 · %2").arg(problem.id).arg(problem.category), problem.id);
+    const QString searchText = problemSearchEdit_ ? problemSearchEdit_->text().trimmed() : QString();
+    if (searchText.isEmpty()) {
+        for (const auto &problem : problems) {
+            problemCombo_->addItem(QStringLiteral("#%1 · %2").arg(problem.id).arg(problem.category), problem.id);
+        }
+    } else {
+        // Search results keep their ranking order.
+        QHash<int, int> indexById;
+        indexById.reserve(problems.size());
+        for (int i = 0; i < problems.size(); ++i) {
+            indexById.insert(problems.at(i).id, i);
+        }
+        for (const int id : problemManager_.search(searchText, kMaxProblemSearchResults)) {
+            const auto it = indexById.constFind(id);
+            if (it == indexById.constEnd()) {
+                continue;
+            }
+            const auto &problem = problems.at(it.value());
+            problemCombo_->addItem(QStringLiteral("#%1 · %2").arg(problem.id).arg(problem.category), problem.id);
+        }
     }
 
     problemCombo_->setEnabled(problemCombo_->count() > 0);
@@ -2405,8 +2516,8 @@ void MainWindow::updateUserPanel() {
     const auto &user = *currentUser_;
     // userSummaryLabel_->setText(user.nickname);
 
-    const QString avatarFile = userManager_.resolvedAvatarPath(user.avatarPath);
-    userMenuButton_->setIcon(QIcon(makeCircularAvatar(avatarFile)));
+    const QString avatarFile = userManager_.avatarThumbnailPath(user.avatarPath, kAvatarIconSize);
+    userMenuButton_->setIcon(QIcon(makeCircularAvatar(avatarFile, kAvatarIconSize)));
     userMenuButton_->setToolTip(tr("%1\n%2").arg(user.nickname, user.email));
 }
 
@@ -2440,6 +2551,7 @@ void MainWindow::updateAnswerOptions() {
     }
     // Keep answers in their original, static order. Do not shuffle the indices.
 
+    ensureAnswerOptions(int(order.size()));
     for (int index = 0; index < answerOptions_.size(); ++index) {
         auto *option = answerOptions_.at(index);
         if (index < order.size()) {
@@ -2481,6 +2593,26 @@ void MainWindow::recordSessionIfNeeded() {
     updateSessionLabels();
 }
 
+void MainWindow::ensureAnswerOptions(int count) {
+    if (!answerButtons_ || answerOptions_.isEmpty() || count <= answerOptions_.size()) {
+        return;
+    }
+
+    // New buttons go right after the last one, above the section's stretch.
+    QVBoxLayout *layout = ui_->questionSectionLayout;
+    while (answerOptions_.size() < count) {
+        QRadioButton *last = answerOptions_.constLast();
+        const int id = int(answerOptions_.size());
+        auto *option = new QRadioButton(ui_->questionSection);
+        option->setObjectName(QStringLiteral("AnswerOption_%1").arg(id));
+        option->setVisible(false);
+        option->setEnabled(last->isEnabled());
+        layout->insertWidget(layout->indexOf(last) + 1, option);
+        answerButtons_->addButton(option, id);
+        answerOptions_.push_back(option);
+    }
+}
+
 void MainWindow::resetAnswerSelection() {
     if (!answerButtons_) {
         return;
@@ -2648,7 +2780,10 @@ QPixmap MainWindow::makeCircularAvatar(const QString &avatarPath, int size) cons
     if (source.isNull()) {
         source.load(kDefaultAvatarPath);
     }
-    QPixmap scaled = source.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    // Prebuilt thumbnails already have the requested size.
+    const QPixmap scaled = source.size() == QSize(size, size)
+                               ? source
+                               : source.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
 
     QPixmap result(size, size);
     result.fill(Qt::transparent);
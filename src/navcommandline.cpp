@@ -0,0 +1,24 @@
+#include "navcommandline.h"
+
+#include <QCoreApplication>
+
+#include <cstdlib>
+
+QTextStream &NavCommandLine::out()
+{
+    static QTextStream s_out(stdout);
+    return s_out;
+}
+
+QTextStream &NavCommandLine::err()
+{
+    static QTextStream s_err(stderr);
+    return s_err;
+}
+
+int NavCommandLine::usage(const char *flag, const char *arguments)
+{
+    err() << "usage: " << QCoreApplication::applicationName() << ' ' << flag << ' ' << arguments << '\n';
+    err().flush();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+#include "navconnectionmanager.h"
+#include "navconnectionprofile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSqlError>
+#include <QTemporaryFile>
+#include <QThread>
+
+namespace {
+struct ThreadConnections
+{
+    QHash<QString, QString> namesByPath;
+    bool                    mainThread = false;
+
+    ~ThreadConnections()
+    {
+        // At process exit the GUI thread's connection may still be held by
+        // the Navigation singleton, which is destroyed after thread locals.
+        if (mainThread)
+            return;
+
+        for (const QString &name : std::as_const(namesByPath)) {
+            {
+                QSqlDatabase db = QSqlDatabase::database(name, false);
+                if (db.isOpen())
+                    db.close();
+            }
+            QSqlDatabase::removeDatabase(name);
+        }
+    }
+};
+
+ThreadConnections &threadConnections()
+{
+    thread_local ThreadConnections t_connections;
+    return t_connections;
+}
+
+QMutex  s_temporaryMutex;
+QString s_temporaryFile;
+
+// Connections may still be open at exit; the files are unlinked anyway.
+void removeTemporaryDatabase()
+{
+    QMutexLocker lock(&s_temporaryMutex);
+    for (const char *suffix : {"", "-wal", "-shm"})
+        QFile::remove(s_temporaryFile + QLatin1String(suffix));
+}
+
+// File behind temporaryPath(), created on first use. SQLite opens the empty
+// file as a new database.
+QString temporaryDatabaseFile(QString *error)
+{
+    QMutexLocker lock(&s_temporaryMutex);
+    if (s_temporaryFile.isEmpty()) {
+        QTemporaryFile file(QDir(QDir::tempPath()).filePath(QStringLiteral("navdb-XXXXXX.sqlite")));
+        file.setAutoRemove(false);
+        if (!file.open()) {
+            if (error)
+                *error = file.errorString();
+            return QString();
+        }
+        s_temporaryFile = file.fileName();
+        qAddPostRoutine(removeTemporaryDatabase);
+    }
+    return s_temporaryFile;
+}
+}
+
+QString NavConnectionManager::temporaryPath()
+{
+    return QStringLiteral(":memory:");
+}
+
+bool NavConnectionManager::isTemporary(const QString &dbFilePath)
+{
+    return dbFilePath == temporaryPath();
+}
+
+QSqlDatabase NavConnectionManager::connection(const QString &dbFilePath, QString *error)
+{
+    ThreadConnections &connections = threadConnections();
+
+    const auto existing = connections.namesByPath.constFind(dbFilePath);
+    if (existing != connections.namesByPath.constEnd()) {
+        QSqlDatabase db = QSqlDatabase::database(existing.value(), false);
+        if (db.isOpen() || db.open())
+            return db;
+        if (error)
+            *error = db.lastError().text();
+        return db;
+    }
+
+    const QString name = QStringLiteral("navdb_%1_%2")
+        .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()))
+        .arg(connections.namesByPath.size());
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+    if (isTemporary(dbFilePath)) {
+        const QString file = temporaryDatabaseFile(error);
+        if (file.isEmpty()) {
+            db = QSqlDatabase();
+            QSqlDatabase::removeDatabase(name);
+            return db;
+        }
+        db.setDatabaseName(file);
+    } else {
+        db.setDatabaseName(dbFilePath);
+    }
+    if (!db.open()) {
+        if (error)
+            *error = db.lastError().text();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+        return db;
+    }
+
+    QString profileError;
+    if (!NavConnectionProfile::active().apply(db, &profileError)) {
+        if (error)
+            *error = profileError;
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+        return db;
+    }
+
+    if (connections.namesByPath.isEmpty()) {
+        const QCoreApplication *app = QCoreApplication::instance();
+        connections.mainThread = !app || QThread::currentThread() == app->thread();
+    }
+    connections.namesByPath.insert(dbFilePath, name);
+    return db;
+}
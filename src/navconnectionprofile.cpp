@@ -0,0 +1,94 @@
+#include "navconnectionprofile.h"
+
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QtGlobal>
+
+namespace {
+NavConnectionProfile profileFromEnvironment()
+{
+    const QString requested = qEnvironmentVariable("PER_DB_PROFILE").trimmed().toLower();
+    if (requested == QLatin1String("fastlab") || requested == QLatin1String("fast_lab")) {
+        return NavConnectionProfile::fastLab();
+    }
+    return NavConnectionProfile::durable();
+}
+
+NavConnectionProfile &activeProfile()
+{
+    static NavConnectionProfile s_profile = profileFromEnvironment();
+    return s_profile;
+}
+
+const char *synchronousKeyword(NavConnectionProfile::Synchronous level)
+{
+    switch (level) {
+    case NavConnectionProfile::Synchronous::Off:
+        return "OFF";
+    case NavConnectionProfile::Synchronous::Normal:
+        return "NORMAL";
+    case NavConnectionProfile::Synchronous::Full:
+        break;
+    }
+    return "FULL";
+}
+}
+
+NavConnectionProfile NavConnectionProfile::durable()
+{
+    NavConnectionProfile p;
+    p.name = QStringLiteral("durable");
+    return p;
+}
+
+NavConnectionProfile NavConnectionProfile::fastLab()
+{
+    NavConnectionProfile p;
+    p.name            = QStringLiteral("fastlab");
+    p.synchronous     = Synchronous::Normal;
+    p.cacheSizeKiB    = 64 * 1024;
+    p.mmapSizeBytes   = qint64(256) * 1024 * 1024;
+    p.tempStoreMemory = true;
+    p.busyTimeoutMs   = 10000;
+    return p;
+}
+
+const NavConnectionProfile &NavConnectionProfile::active()
+{
+    return activeProfile();
+}
+
+void NavConnectionProfile::setActive(const NavConnectionProfile &profile)
+{
+    activeProfile() = profile;
+}
+
+bool NavConnectionProfile::apply(QSqlDatabase &db, QString *error) const
+{
+    // busy_timeout goes first so the journal switch can wait for other writers.
+    const QStringList pragmas{
+        QStringLiteral("PRAGMA busy_timeout = %1;").arg(busyTimeoutMs),
+        QStringLiteral("PRAGMA foreign_keys = ON;"),
+        QStringLiteral("PRAGMA journal_mode = %1;")
+            .arg(walJournal ? QStringLiteral("WAL") : QStringLiteral("DELETE")),
+        QStringLiteral("PRAGMA synchronous = %1;")
+            .arg(QString::fromLatin1(synchronousKeyword(synchronous))),
+        QStringLiteral("PRAGMA cache_size = -%1;").arg(cacheSizeKiB),
+        QStringLiteral("PRAGMA mmap_size = %1;").arg(mmapSizeBytes),
+        QStringLiteral("PRAGMA temp_store = %1;")
+            .arg(tempStoreMemory ? QStringLiteral("MEMORY") : QStringLiteral("DEFAULT"))
+    };
+
+    QSqlQuery q(db);
+    for (const QString &pragma : pragmas) {
+        if (!q.exec(pragma)) {
+            if (error) {
+                *error = QStringLiteral("%1: %2").arg(pragma, q.lastError().text());
+            }
+            return false;
+        }
+        q.finish();
+    }
+    return true;
+}
@@ -4,29 +4,78 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QFileInfo>
+#include <QObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <exception>
 
 namespace {
+QString &databasePathOverride()
+{
+    static QString s_path;
+    return s_path;
+}
+
 QString resolveDatabasePath()
 {
+    if (!databasePathOverride().isEmpty()) {
+        return databasePathOverride();
+    }
+
     QDir appDir(QCoreApplication::applicationDirPath());
     const QString localPath = appDir.filePath(QStringLiteral("navdb.sqlite"));
     if (QFileInfo::exists(localPath)) {
         return localPath;
     }
 
+    // Shared by NavigationDAO, UserManager and ProblemManager, so it also
+    // covers the project-folder layouts those used to probe on their own.
+    const QStringList candidates{
+        QStringLiteral("navdb.sqlite"),
+        QStringLiteral("navdb/navdb.sqlite"),
+        QStringLiteral("IHM_PER_QT/navdb.sqlite")
+    };
+
     QDir dir(appDir);
-    for (int i = 0; i < 4; ++i) {
+    for (int i = 0; i < 5; ++i) {
         if (!dir.cdUp()) {
             break;
         }
-        const QString candidate = dir.filePath(QStringLiteral("navdb.sqlite"));
-        if (QFileInfo::exists(candidate)) {
-            return candidate;
+        for (const QString &name : candidates) {
+            const QString candidate = dir.filePath(name);
+            if (QFileInfo::exists(candidate)) {
+                return candidate;
+            }
         }
     }
 
     return localPath;
 }
+
+// Writes user and its sessions in one transaction; returns the session rowids.
+QVector<qint64> storeUser(NavigationDAO &dao, User &user, const char *where)
+{
+    const QVector<Session> sessions = user.sessions();
+    QVector<qint64> rowIds;
+    dao.writeTransaction(where, [&] {
+        // A retried attempt starts again from an unsaved user.
+        user.setInsertedInDb(false);
+        user.setSessions({});
+        rowIds.clear();
+        dao.saveUser(user);
+        for (const Session &s : sessions) {
+            rowIds.push_back(dao.addSession(user.nickName(), s));
+        }
+    });
+    user.setSessions(sessions);
+    return rowIds;
+}
+
+QString errorText(const std::exception &ex)
+{
+    return QString::fromUtf8(ex.what());
+}
 }
 
 Navigation &Navigation::instance()
@@ -35,16 +84,88 @@ Navigation &Navigation::instance()
     return s_instance;
 }
 
+void Navigation::setDatabasePath(const QString &path)
+{
+    databasePathOverride() = path;
+}
+
 Navigation::Navigation()
     : m_dao(resolveDatabasePath())
 {
-    loadFromDb();
+    // Nothing is read yet: the GUI starts with loadAsync(), anything else
+    // gets a synchronous load from its first reload().
+}
+
+AsyncNavigationDAO &Navigation::asyncDao()
+{
+    if (!m_asyncDao) {
+        m_asyncDao = std::make_unique<AsyncNavigationDAO>(m_dao.databasePath());
+    }
+    return *m_asyncDao;
 }
 
 void Navigation::loadFromDb()
 {
-    m_users    = m_dao.loadUsers();
+    // Probes first: a commit racing with the load is seen again next time.
+    m_dataVersion = m_dao.dataVersion();
+    m_counters    = m_dao.changeCounters();
+
+    m_users    = m_dao.loadUsers(&m_sessionWatermark);
     m_problems = m_dao.loadProblems();
+
+    m_loaded      = true;
+    m_localWrites = false;
+    m_localSessionRows.clear();
+    m_localChangedUsers.clear();
+    m_localRemovedUsers.clear();
+}
+
+QFuture<QString> Navigation::loadAsync(QObject *context)
+{
+    // Probes first, on this thread's connection, since reload() compares
+    // against it; they are a pragma and one small read.
+    qint64 dataVersion = -1;
+    NavigationDAO::ChangeCounters counters;
+    try {
+        dataVersion = m_dao.dataVersion();
+        counters    = m_dao.changeCounters();
+    } catch (const std::exception &ex) {
+        return QtFuture::makeReadyFuture(errorText(ex));
+    }
+
+    return asyncDao()
+        .run([](NavigationDAO &dao) {
+            Snapshot snapshot;
+            snapshot.users    = dao.loadUsers(&snapshot.sessionWatermark);
+            snapshot.problems = dao.loadProblems();
+            return snapshot;
+        })
+        .then(context, [this, dataVersion, counters](Snapshot snapshot) {
+            adoptSnapshot(std::move(snapshot), dataVersion, counters);
+            return QString();
+        })
+        .onFailed(context, [](const std::exception &ex) { return errorText(ex); });
+}
+
+void Navigation::adoptSnapshot(Snapshot snapshot, qint64 dataVersion,
+                               const NavigationDAO::ChangeCounters &counters)
+{
+    // A reload() in the meantime already loaded something at least as new.
+    if (m_loaded) {
+        return;
+    }
+
+    m_dataVersion      = dataVersion;
+    m_counters         = counters;
+    m_users            = std::move(snapshot.users);
+    m_sessionWatermark = snapshot.sessionWatermark;
+    m_problems         = std::move(snapshot.problems);
+
+    m_loaded      = true;
+    m_localWrites = false;
+    m_localSessionRows.clear();
+    m_localChangedUsers.clear();
+    m_localRemovedUsers.clear();
 }
 
 User *Navigation::findUser(const QString &nick)
@@ -63,6 +184,15 @@ const User *Navigation::findUser(const QString &nick) const
     return &(*it);
 }
 
+const Problem *Navigation::findProblem(qint64 id) const
+{
+    auto it = std::lower_bound(m_problems.cbegin(), m_problems.cend(), id,
+                               [](const Problem &p, qint64 key) { return p.id() < key; });
+    if (it == m_problems.cend() || it->id() != id)
+        return nullptr;
+    return &(*it);
+}
+
 User *Navigation::authenticate(const QString &nick, const QString &password)
 {
     User *u = findUser(nick);
@@ -80,8 +210,43 @@ void Navigation::addUser(User &user)
             QStringLiteral("Navigation::addUser: user '%1' already exists").arg(nick));
     }
 
-    m_dao.saveUser(user);
+    // Sessions are written one by one so their rowids are known to reload().
+    adoptUser(user, storeUser(m_dao, user, "Navigation::addUser"));
+}
+
+QFuture<QString> Navigation::addUserAsync(const User &user, QObject *context)
+{
+    const QString nick = user.nickName();
+    if (m_users.contains(nick)) {
+        return QtFuture::makeReadyFuture(
+            QStringLiteral("Navigation::addUserAsync: user '%1' already exists").arg(nick));
+    }
+
+    return asyncDao()
+        .run([user](NavigationDAO &dao) mutable {
+            StoredUser stored;
+            stored.sessionRows = storeUser(dao, user, "Navigation::addUserAsync");
+            stored.user        = user;
+            return stored;
+        })
+        .then(context, [this](const StoredUser &stored) {
+            adoptUser(stored.user, stored.sessionRows);
+            return QString();
+        })
+        .onFailed(context, [](const std::exception &ex) { return errorText(ex); });
+}
+
+void Navigation::adoptUser(const User &user, const QVector<qint64> &sessionRows)
+{
+    const QString &nick = user.nickName();
+    for (qint64 rowId : sessionRows) {
+        m_localSessionRows.insert(rowId);
+    }
+
     m_users.insert(nick, user);
+    m_localWrites = true;
+    m_localChangedUsers.insert(nick);
+    m_localRemovedUsers.remove(nick);
 }
 
 void Navigation::updateUser(const User &user)
@@ -95,6 +260,9 @@ void Navigation::updateUser(const User &user)
 
     m_dao.updateUser(user);
     m_users[nick] = user;
+    m_users[nick].clearDirtyFields();
+    m_localWrites = true;
+    m_localChangedUsers.insert(nick);
 }
 
 void Navigation::removeUser(const QString &nickName)
@@ -106,6 +274,9 @@ void Navigation::removeUser(const QString &nickName)
 
     m_dao.deleteUser(nickName);
     m_users.remove(nickName);
+    m_localWrites = true;
+    m_localChangedUsers.remove(nickName);
+    m_localRemovedUsers.insert(nickName);
 }
 
 void Navigation::addSession(const QString &nickName, const Session &session)
@@ -116,11 +287,125 @@ void Navigation::addSession(const QString &nickName, const Session &session)
             QStringLiteral("Navigation::addSession: user '%1' does not exist").arg(nickName));
     }
 
-    m_dao.addSession(nickName, session);
+    m_localSessionRows.insert(m_dao.addSession(nickName, session));
     it.value().addSession(session);
+    m_localWrites = true;
+    m_localChangedUsers.insert(nickName);
+}
+
+Navigation::ReloadResult Navigation::reload()
+{
+    // Writes queued on the database thread must be visible to the reload.
+    if (m_asyncDao) {
+        m_asyncDao->waitForIdle();
+    }
+
+    if (!m_loaded) {
+        loadFromDb();
+        ReloadResult result;
+        result.full = true;
+        result.problemsChanged = true;
+        return result;
+    }
+
+    ReloadResult result;
+    result.changedUsers = m_localChangedUsers;
+    result.removedUsers = m_localRemovedUsers;
+    m_localChangedUsers.clear();
+    m_localRemovedUsers.clear();
+
+    // data_version only moves for commits made by other connections; our own
+    // writes are covered by m_localWrites.
+    const qint64 dataVersion = m_dao.dataVersion();
+    if (dataVersion == m_dataVersion && !m_localWrites) {
+        return result;
+    }
+
+    const NavigationDAO::ChangeCounters counters = m_dao.changeCounters();
+    m_dataVersion = dataVersion;
+    m_localWrites = false;
+
+    if (counters.users != m_counters.users) {
+        patchUsers(result);
+    }
+
+    if (counters.sessions != m_counters.sessions
+        && !patchSessions(counters.sessions - m_counters.sessions, result)) {
+        // Something other than appends happened (edits, deletes, cascades).
+        loadFromDb();
+        result = ReloadResult();
+        result.full = true;
+        result.problemsChanged = true;
+        return result;
+    }
+
+    if (counters.problems != m_counters.problems) {
+        m_problems = m_dao.loadProblems();
+        result.problemsChanged = true;
+    }
+
+    m_counters = counters;
+    return result;
 }
 
-void Navigation::reload()
+void Navigation::patchUsers(ReloadResult &result)
 {
-    loadFromDb();
+    // The user table is small; diff it and keep the sessions already cached.
+    QMap<QString, User> fresh = m_dao.loadUserRows();
+
+    for (auto it = m_users.begin(); it != m_users.end();) {
+        if (!fresh.contains(it.key())) {
+            result.removedUsers.insert(it.key());
+            result.changedUsers.remove(it.key());
+            it = m_users.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = fresh.begin(); it != fresh.end(); ++it) {
+        User &row = it.value();
+        auto current = m_users.find(it.key());
+        if (current == m_users.end()) {
+            m_users.insert(it.key(), row);
+            result.changedUsers.insert(it.key());
+            result.removedUsers.remove(it.key());
+            continue;
+        }
+
+        if (current->email() != row.email()
+            || current->password() != row.password()
+            || current->birthdate() != row.birthdate()) {
+            result.changedUsers.insert(it.key());
+        }
+        // Fresh row, cached sessions; the avatar handle is re-armed so an
+        // avatar replaced elsewhere is read again on next use.
+        row.setSessions(current->sessions());
+        *current = row;
+    }
+}
+
+bool Navigation::patchSessions(qint64 expectedRows, ReloadResult &result)
+{
+    // Every inserted row bumps the counter once. If the counter moved by more
+    // than the rows appended after the watermark, rows were changed in place.
+    const QVector<NavigationDAO::SessionRow> rows = m_dao.loadSessionsAfter(m_sessionWatermark);
+    if (rows.size() != expectedRows) {
+        return false;
+    }
+
+    for (const NavigationDAO::SessionRow &row : rows) {
+        m_sessionWatermark = std::max(m_sessionWatermark, row.rowId);
+        if (m_localSessionRows.remove(row.rowId)) {
+            continue;
+        }
+
+        auto owner = m_users.find(row.nickName);
+        if (owner == m_users.end()) {
+            continue;
+        }
+        owner->addSession(row.session);
+        result.changedUsers.insert(row.nickName);
+    }
+    return true;
 }
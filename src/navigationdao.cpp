@@ -1,16 +1,56 @@
 #include "navigationdao.h"
+#include "navconnectionmanager.h"
+#include "navoptionscodec.h"
+#include "navquerystats.h"
 
 #include <QSqlDatabase>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QThread>
 #include <QVariant>
 
+#include <algorithm>
+#include <limits>
+
+namespace {
+// Bounds for writeTransaction(): each attempt already waits busy_timeout
+// for the lock, the pause between attempts only breaks up lock-step retries.
+constexpr int kWriteAttempts  = 4;
+constexpr int kRetryBaseMs    = 25;
+constexpr int kRetryMaxMs     = 400;
+
+bool isBusyError(const QSqlError &err)
+{
+    // SQLITE_BUSY and SQLITE_LOCKED, with or without an extended code.
+    bool ok = false;
+    const int code = err.nativeErrorCode().toInt(&ok) & 0xff;
+    return ok && (code == 5 || code == 6);
+}
+
+// Column order handed to NavRowDecoder by the row builders below.
+enum UserColumn { UserNickName, UserEmail, UserPassword, UserBirthdate };
+enum SessionColumn { SessionTimeStamp, SessionTimeStampMs, SessionHits, SessionFaults };
+
+NavRowDecoder userColumns(const QSqlQuery &q)
+{
+    return NavRowDecoder(q, {"nickName", "email", "password", "birthdate"});
+}
+
+NavRowDecoder sessionColumns(const QSqlQuery &q)
+{
+    return NavRowDecoder(q, {"timeStamp", "timeStampMs", "hits", "faults"});
+}
+}
+
 NavigationDAO::NavigationDAO(const QString &dbFilePath)
     : m_dbFilePath(dbFilePath)
 {
-    m_connectionName = QStringLiteral("navdb_%1")
-        .arg(reinterpret_cast<quintptr>(this));
-
     open();
     createTablesIfNeeded();
+    runMigrations();
+    createProblemSearchIndex();
 }
 
 NavigationDAO::~NavigationDAO()
@@ -20,31 +60,22 @@ NavigationDAO::~NavigationDAO()
 
 void NavigationDAO::open()
 {
-    if (QSqlDatabase::contains(m_connectionName)) {
-        m_db = QSqlDatabase::database(m_connectionName);
-    } else {
-        m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
-        m_db.setDatabaseName(m_dbFilePath);
-    }
+    QString error;
+    m_db = NavConnectionManager::connection(m_dbFilePath, &error);
 
-    if (!m_db.open()) {
+    if (!m_db.isOpen()) {
         throw NavDAOException(
             QStringLiteral("NavigationDAO: error opening database '%1': %2")
-                .arg(m_dbFilePath, m_db.lastError().text()));
+                .arg(m_dbFilePath, error));
     }
-
-    QSqlQuery pragma(m_db);
-    pragma.exec(QStringLiteral("PRAGMA foreign_keys = ON;"));
 }
 
 void NavigationDAO::close()
 {
-    if (m_db.isOpen())
-        m_db.close();
-
-    if (QSqlDatabase::contains(m_connectionName)) {
-        QSqlDatabase::removeDatabase(m_connectionName);
-    }
+    // The connection belongs to NavConnectionManager and stays open for the
+    // other users on this thread; only this DAO's statements are released.
+    m_statements.clear();
+    m_db = QSqlDatabase();
 }
 
 void NavigationDAO::createTablesIfNeeded()
@@ -52,6 +83,7 @@ void NavigationDAO::createTablesIfNeeded()
     createUserTable();
     createSessionTable();
     createProblemTable();
+    createHistoryTable();
 }
 
 void NavigationDAO::createUserTable()
@@ -113,36 +145,958 @@ void NavigationDAO::createProblemTable()
     }
 }
 
-QMap<QString, User> NavigationDAO::loadUsers()
+void NavigationDAO::createHistoryTable()
+{
+    const char *sql =
+        "CREATE TABLE IF NOT EXISTS question_history ("
+        "userNickName     TEXT NOT NULL,"
+        "sessionTimestamp TEXT NOT NULL,"
+        "attemptTimestamp TEXT,"
+        "problemId        INTEGER,"
+        "question         TEXT,"
+        "selectedAnswer   TEXT,"
+        "correctAnswer    TEXT,"
+        "wasCorrect       INTEGER NOT NULL,"
+        "optionsJson      TEXT,"
+        "selectedIndex    INTEGER,"
+        "PRIMARY KEY(userNickName, sessionTimestamp, attemptTimestamp, question)"
+        ");";
+
+    QSqlQuery q(m_db);
+    if (!q.exec(QString::fromUtf8(sql))) {
+        throwSqlError("createHistoryTable", q.lastError());
+    }
+}
+
+void NavigationDAO::createProblemSearchIndex()
+{
+    // Not a migration: FTS5 is optional in SQLite builds, and a database
+    // moved to a build that has it should still get the index.
+    QSqlQuery probe(m_db);
+    if (!probe.exec(QStringLiteral("SELECT 1 FROM sqlite_master "
+                                   "WHERE type='table' AND name='problem_fts';"))) {
+        throwSqlError("createProblemSearchIndex.probe", probe.lastError());
+    }
+    const bool exists = probe.next();
+    probe.finish();
+
+    if (!exists) {
+        const char *sql =
+            "CREATE VIRTUAL TABLE problem_fts USING fts5("
+            "text, answers, tokenize = 'unicode61 remove_diacritics 2'"
+            ");";
+
+        QSqlQuery q(m_db);
+        if (!q.exec(QString::fromUtf8(sql))) {
+            m_hasProblemSearch = false;
+            return;
+        }
+    }
+    m_hasProblemSearch = true;
+
+    // The bank may have been edited by hand (see the README) since the index
+    // was built; the 'problem' counter tells, as problem_answer bumps it too.
+    // Checked again under the write lock, another instance may rebuild first.
+    if (!problemSearchIndexStale()) {
+        return;
+    }
+    writeTransaction("createProblemSearchIndex", [this] {
+        if (problemSearchIndexStale()) {
+            rebuildProblemSearchIndex();
+        }
+    });
+}
+
+bool NavigationDAO::problemSearchIndexStale()
+{
+    QSqlQuery q(m_db);
+    if (!q.exec(QStringLiteral("SELECT (SELECT version FROM change_counter WHERE tableName = 'problem') "
+                               "IS NOT (SELECT version FROM change_counter WHERE tableName = 'problem_fts');"))
+        || !q.next()) {
+        throwSqlError("problemSearchIndexStale", q.lastError());
+    }
+    return q.value(0).toInt() != 0;
+}
+
+void NavigationDAO::rebuildProblemSearchIndex()
+{
+    // The index rowid is the problem id; answers are indexed as one column.
+    execSql("rebuildProblemSearchIndex.clear", QStringLiteral("DELETE FROM problem_fts;"));
+    execSql("rebuildProblemSearchIndex.fill",
+            QStringLiteral("INSERT INTO problem_fts(rowid, text, answers) "
+                           "SELECT p.id, coalesce(p.text, ''), "
+                           "coalesce((SELECT group_concat(a.text, ' ') FROM problem_answer a "
+                           "WHERE a.problemId = p.id), '') "
+                           "FROM problem p;"));
+    // Records which state of the bank the index reflects. No trigger watches
+    // this row, and changeCounters() skips names it does not know.
+    execSql("rebuildProblemSearchIndex.mark",
+            QStringLiteral("INSERT OR REPLACE INTO change_counter(tableName, version) "
+                           "SELECT 'problem_fts', version FROM change_counter "
+                           "WHERE tableName = 'problem';"));
+}
+
+const QVector<NavigationDAO::Migration> &NavigationDAO::migrations()
+{
+    // Append only: a step's version is persisted in PRAGMA user_version.
+    static const QVector<Migration> s_migrations{
+        {1, "session lookup index", &NavigationDAO::migrateSessionIndexes},
+        {2, "question_history lookup index", &NavigationDAO::migrateHistoryIndexes},
+        {3, "user_avatar table", &NavigationDAO::migrateAvatarTable},
+        {4, "epoch millisecond timestamps", &NavigationDAO::migrateEpochTimestamps},
+        {5, "change counters", &NavigationDAO::migrateChangeCounters},
+        {6, "user_daily_stats aggregate", &NavigationDAO::migrateDailyStats},
+        {7, "question_history attempt ids", &NavigationDAO::migrateAttemptIds},
+        {8, "problem_answer table", &NavigationDAO::migrateProblemAnswers},
+        {9, "stable problem ids", &NavigationDAO::migrateProblemIds},
+        {10, "canonical session keys", &NavigationDAO::migrateSessionKeys},
+        {11, "daily attempts follow their session", &NavigationDAO::migrateDailyAttempts},
+        {12, "drop redundant history index", &NavigationDAO::migrateDropHistoryIndex},
+    };
+    return s_migrations;
+}
+
+int NavigationDAO::schemaVersion()
+{
+    QSqlQuery q(m_db);
+    if (!q.exec(QStringLiteral("PRAGMA user_version;")) || !q.next()) {
+        throwSqlError("schemaVersion", q.lastError());
+    }
+    return q.value(0).toInt();
+}
+
+void NavigationDAO::runMigrations()
+{
+    const int current = schemaVersion();
+
+    for (const Migration &m : migrations()) {
+        if (m.version <= current)
+            continue;
+
+        const QByteArray where = QStringLiteral("migration %1 (%2)")
+                                     .arg(m.version)
+                                     .arg(QString::fromUtf8(m.description))
+                                     .toUtf8();
+        writeTransaction(where.constData(), [this, &m] {
+            // Another instance may have applied it while this one waited.
+            if (schemaVersion() >= m.version)
+                return;
+            (this->*m.apply)();
+            execSql("migration.user_version",
+                    QStringLiteral("PRAGMA user_version = %1;").arg(m.version));
+        });
+    }
+}
+
+void NavigationDAO::writeTransaction(const char *where, const std::function<void()> &body)
+{
+    const QString name = QString::fromUtf8(where);
+
+    for (int attempt = 1;; ++attempt) {
+        try {
+            QSqlQuery q(m_db);
+            if (!q.exec(QStringLiteral("BEGIN IMMEDIATE;"))) {
+                throwSqlError(name + QStringLiteral(".begin"), q.lastError());
+            }
+
+            try {
+                body();
+                if (!q.exec(QStringLiteral("COMMIT;"))) {
+                    throwSqlError(name + QStringLiteral(".commit"), q.lastError());
+                }
+            } catch (...) {
+                QSqlQuery rollback(m_db);
+                rollback.exec(QStringLiteral("ROLLBACK;"));
+                throw;
+            }
+            return;
+        } catch (const NavDAOBusyException &) {
+            if (attempt >= kWriteAttempts)
+                throw;
+        }
+
+        ++m_busyRetries;
+        const int ceiling = qMin(kRetryMaxMs, kRetryBaseMs << (attempt - 1));
+        QThread::msleep(ulong(ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1)));
+    }
+}
+
+void NavigationDAO::migrateSessionIndexes()
+{
+    // Covers loadSessionsFor() and the grouped scan in loadAllSessionsInto().
+    execSql("migrateSessionIndexes",
+            QStringLiteral("CREATE INDEX IF NOT EXISTS idx_session_user "
+                           "ON session(userNickName, timeStamp, hits, faults);"));
+}
+
+void NavigationDAO::migrateHistoryIndexes()
+{
+    // Kept for its version number only. It used to create idx_history_session,
+    // a prefix of the primary key; migration 12 drops it where it exists.
+}
+
+void NavigationDAO::migrateAvatarTable()
+{
+    // Keeps the user rows narrow: loadUsers() no longer drags PNG blobs along.
+    execSql("migrateAvatarTable.create",
+            QStringLiteral("CREATE TABLE IF NOT EXISTS user_avatar ("
+                           "nickName TEXT PRIMARY KEY"
+                           "  REFERENCES user(nickName)"
+                           "  ON UPDATE CASCADE"
+                           "  ON DELETE CASCADE,"
+                           "png      BLOB NOT NULL"
+                           ");"));
+    execSql("migrateAvatarTable.copy",
+            QStringLiteral("INSERT OR REPLACE INTO user_avatar(nickName, png) "
+                           "SELECT nickName, avatar FROM user "
+                           "WHERE avatar IS NOT NULL AND length(avatar) > 0;"));
+    execSql("migrateAvatarTable.clear",
+            QStringLiteral("UPDATE user SET avatar = NULL WHERE avatar IS NOT NULL;"));
+}
+
+void NavigationDAO::migrateEpochTimestamps()
+{
+    // Integer copies of the ISO timestamps: indexable and read without parsing.
+    execSql("migrateEpochTimestamps.session",
+            QStringLiteral("ALTER TABLE session ADD COLUMN timeStampMs INTEGER;"));
+    execSql("migrateEpochTimestamps.historySession",
+            QStringLiteral("ALTER TABLE question_history ADD COLUMN sessionTimestampMs INTEGER;"));
+    execSql("migrateEpochTimestamps.historyAttempt",
+            QStringLiteral("ALTER TABLE question_history ADD COLUMN attemptTimestampMs INTEGER;"));
+
+    backfillEpochColumn("session", "timeStamp", "timeStampMs");
+    backfillEpochColumn("question_history", "sessionTimestamp", "sessionTimestampMs");
+    backfillEpochColumn("question_history", "attemptTimestamp", "attemptTimestampMs");
+
+    execSql("migrateEpochTimestamps.dropSessionIndex",
+            QStringLiteral("DROP INDEX IF EXISTS idx_session_user;"));
+    execSql("migrateEpochTimestamps.sessionIndex",
+            QStringLiteral("CREATE INDEX IF NOT EXISTS idx_session_user_time "
+                           "ON session(userNickName, timeStampMs, hits, faults);"));
+    execSql("migrateEpochTimestamps.historyIndex",
+            QStringLiteral("CREATE INDEX IF NOT EXISTS idx_history_session_time "
+                           "ON question_history(userNickName, sessionTimestampMs, attemptTimestampMs);"));
+}
+
+void NavigationDAO::migrateChangeCounters()
+{
+    // One counter per in-memory collection; Navigation::reload() compares
+    // them to decide which parts of its cache are stale.
+    execSql("migrateChangeCounters.create",
+            QStringLiteral("CREATE TABLE IF NOT EXISTS change_counter ("
+                           "tableName TEXT PRIMARY KEY,"
+                           "version   INTEGER NOT NULL DEFAULT 0"
+                           ") WITHOUT ROWID;"));
+    execSql("migrateChangeCounters.seed",
+            QStringLiteral("INSERT OR IGNORE INTO change_counter(tableName, version) "
+                           "VALUES('user', 0), ('session', 0), ('problem', 0);"));
+
+    // user_avatar rows belong to the user collection.
+    static const struct { const char *table; const char *counter; } watched[] = {
+        {"user",        "user"},
+        {"user_avatar", "user"},
+        {"session",     "session"},
+        {"problem",     "problem"},
+    };
+    for (const auto &w : watched) {
+        createCounterTriggers(w.table, w.counter);
+    }
+}
+
+void NavigationDAO::createCounterTriggers(const char *table, const char *counter)
+{
+    static const char *events[] = {"INSERT", "UPDATE", "DELETE"};
+
+    const QString name = QString::fromLatin1(table);
+    for (const char *event : events) {
+        const QString ev = QString::fromLatin1(event);
+        execSql("createCounterTriggers",
+                QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_%1_%2_counter "
+                               "AFTER %3 ON %1 BEGIN "
+                               "UPDATE change_counter SET version = version + 1 "
+                               "WHERE tableName = '%4'; "
+                               "END;")
+                    .arg(name, ev.toLower(), ev, QString::fromLatin1(counter)));
+    }
+}
+
+void NavigationDAO::migrateDailyStats()
+{
+    // Per-user, per-day totals kept by triggers, so the statistics panel reads
+    // a handful of rows instead of the whole history.
+    execSql("migrateDailyStats.create",
+            QStringLiteral("CREATE TABLE IF NOT EXISTS user_daily_stats ("
+                           "userNickName    TEXT NOT NULL"
+                           "  REFERENCES user(nickName)"
+                           "  ON UPDATE CASCADE"
+                           "  ON DELETE CASCADE,"
+                           "day             TEXT NOT NULL,"
+                           "sessions        INTEGER NOT NULL DEFAULT 0,"
+                           "hits            INTEGER NOT NULL DEFAULT 0,"
+                           "faults          INTEGER NOT NULL DEFAULT 0,"
+                           "attempts        INTEGER NOT NULL DEFAULT 0,"
+                           "correctAttempts INTEGER NOT NULL DEFAULT 0,"
+                           "lastSessionMs   INTEGER,"
+                           "PRIMARY KEY(userNickName, day)"
+                           ") WITHOUT ROWID;"));
+
+    // Sessions count towards the local day they started on; attempts towards
+    // the day of the session they belong to.
+    const QString sessionDay = QStringLiteral("date(%1.timeStampMs / 1000, 'unixepoch', 'localtime')");
+    const QString historyDay = QStringLiteral("date(%1.sessionTimestampMs / 1000, 'unixepoch', 'localtime')");
+
+    // Written as INSERT ... SELECT so the same statements serve UPDATE triggers,
+    // where either side of the row may lack a timestamp.
+    const QString addSession = QStringLiteral(
+        "INSERT INTO user_daily_stats(userNickName, day, sessions, hits, faults, lastSessionMs) "
+        "SELECT NEW.userNickName, %1, 1, coalesce(NEW.hits, 0), coalesce(NEW.faults, 0), NEW.timeStampMs "
+        "WHERE NEW.timeStampMs IS NOT NULL "
+        "ON CONFLICT(userNickName, day) DO UPDATE SET "
+        "sessions = sessions + 1, "
+        "hits = hits + excluded.hits, "
+        "faults = faults + excluded.faults, "
+        "lastSessionMs = max(coalesce(lastSessionMs, 0), excluded.lastSessionMs);")
+        .arg(sessionDay.arg(QStringLiteral("NEW")));
+    const QString removeSession = QStringLiteral(
+        "UPDATE user_daily_stats SET "
+        "sessions = sessions - 1, "
+        "hits = hits - coalesce(OLD.hits, 0), "
+        "faults = faults - coalesce(OLD.faults, 0) "
+        "WHERE OLD.timeStampMs IS NOT NULL "
+        "AND userNickName = OLD.userNickName AND day = %1;")
+        .arg(sessionDay.arg(QStringLiteral("OLD")));
+
+    const QString addAttempt = QStringLiteral(
+        "INSERT INTO user_daily_stats(userNickName, day, attempts, correctAttempts) "
+        "VALUES(NEW.userNickName, %1, 1, NEW.wasCorrect <> 0) "
+        "ON CONFLICT(userNickName, day) DO UPDATE SET "
+        "attempts = attempts + 1, "
+        "correctAttempts = correctAttempts + excluded.correctAttempts;")
+        .arg(historyDay.arg(QStringLiteral("NEW")));
+    const QString removeAttempt = QStringLiteral(
+        "UPDATE user_daily_stats SET "
+        "attempts = attempts - 1, "
+        "correctAttempts = correctAttempts - (OLD.wasCorrect <> 0) "
+        "WHERE userNickName = OLD.userNickName AND day = %1;")
+        .arg(historyDay.arg(QStringLiteral("OLD")));
+
+    execSql("migrateDailyStats.sessionInsert",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_session_insert_daily "
+                           "AFTER INSERT ON session BEGIN %1 END;").arg(addSession));
+    execSql("migrateDailyStats.sessionDelete",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_session_delete_daily "
+                           "AFTER DELETE ON session BEGIN %1 END;").arg(removeSession));
+    execSql("migrateDailyStats.sessionUpdate",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_session_update_daily "
+                           "AFTER UPDATE OF userNickName, timeStampMs, hits, faults ON session "
+                           "BEGIN %1 %2 END;").arg(removeSession, addSession));
+    // History rows can be deleted as well as inserted, so the DELETE
+    // triggers matter as much as the INSERT ones.
+    execSql("migrateDailyStats.historyInsert",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_history_insert_daily "
+                           "AFTER INSERT ON question_history WHEN NEW.sessionTimestampMs IS NOT NULL "
+                           "BEGIN %1 END;").arg(addAttempt));
+    execSql("migrateDailyStats.historyDelete",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_history_delete_daily "
+                           "AFTER DELETE ON question_history WHEN OLD.sessionTimestampMs IS NOT NULL "
+                           "BEGIN %1 END;").arg(removeAttempt));
+
+    // Seed from the existing history; orphaned rows would trip the foreign key.
+    execSql("migrateDailyStats.seedSessions",
+            QStringLiteral("INSERT INTO user_daily_stats(userNickName, day, sessions, hits, faults, lastSessionMs) "
+                           "SELECT userNickName, %1, count(*), total(hits), total(faults), max(timeStampMs) "
+                           "FROM session WHERE timeStampMs IS NOT NULL "
+                           "AND userNickName IN (SELECT nickName FROM user) "
+                           "GROUP BY 1, 2;").arg(sessionDay.arg(QStringLiteral("session"))));
+    execSql("migrateDailyStats.seedAttempts",
+            QStringLiteral("INSERT INTO user_daily_stats(userNickName, day, attempts, correctAttempts) "
+                           "SELECT userNickName, %1, count(*), sum(wasCorrect <> 0) "
+                           "FROM question_history WHERE sessionTimestampMs IS NOT NULL "
+                           "AND userNickName IN (SELECT nickName FROM user) "
+                           "GROUP BY 1, 2 "
+                           "ON CONFLICT(userNickName, day) DO UPDATE SET "
+                           "attempts = excluded.attempts, "
+                           "correctAttempts = excluded.correctAttempts;")
+                .arg(historyDay.arg(QStringLiteral("question_history"))));
+}
+
+void NavigationDAO::migrateAttemptIds()
+{
+    // Attempts are written one at a time as they are answered; the id makes
+    // a repeated write of the same attempt a no-op instead of a duplicate.
+    execSql("migrateAttemptIds.column",
+            QStringLiteral("ALTER TABLE question_history ADD COLUMN attemptId TEXT;"));
+    execSql("migrateAttemptIds.backfill",
+            QStringLiteral("UPDATE question_history SET attemptId = lower(hex(randomblob(16))) "
+                           "WHERE attemptId IS NULL;"));
+    execSql("migrateAttemptIds.index",
+            QStringLiteral("CREATE UNIQUE INDEX IF NOT EXISTS idx_history_attempt "
+                           "ON question_history(attemptId);"));
+}
+
+void NavigationDAO::migrateProblemAnswers()
+{
+    // One row per answer instead of four fixed answerN/valN columns, with
+    // validity stored as an integer. problemId is the problem rowid.
+    execSql("migrateProblemAnswers.create",
+            QStringLiteral("CREATE TABLE IF NOT EXISTS problem_answer ("
+                           "problemId INTEGER NOT NULL,"
+                           "ordinal   INTEGER NOT NULL,"
+                           "text      TEXT NOT NULL,"
+                           "validity  INTEGER NOT NULL DEFAULT 0,"
+                           "PRIMARY KEY(problemId, ordinal)"
+                           ") WITHOUT ROWID;"));
+    // A rowid cannot be a foreign key target, so deletes cascade by trigger.
+    execSql("migrateProblemAnswers.cascade",
+            QStringLiteral("CREATE TRIGGER IF NOT EXISTS trg_problem_delete_answers "
+                           "AFTER DELETE ON problem BEGIN "
+                           "DELETE FROM problem_answer WHERE problemId = OLD.rowid; "
+                           "END;"));
+    createCounterTriggers("problem_answer", "problem");
+
+    // The old columns held "1"/"0" or "true"/"false"; empty slots are dropped.
+    for (int n = 1; n <= 4; ++n) {
+        execSql("migrateProblemAnswers.copy",
+                QStringLiteral("INSERT OR IGNORE INTO problem_answer(problemId, ordinal, text, validity) "
+                               "SELECT rowid, %2, answer%1, "
+                               "CASE lower(trim(CAST(val%1 AS TEXT))) "
+                               "WHEN 'true' THEN 1 WHEN 'false' THEN 0 "
+                               "ELSE coalesce(CAST(val%1 AS INTEGER) <> 0, 0) END "
+                               "FROM problem WHERE answer%1 IS NOT NULL AND answer%1 <> '';")
+                    .arg(n)
+                    .arg(n - 1));
+    }
+    execSql("migrateProblemAnswers.clear",
+            QStringLiteral("UPDATE problem SET answer1 = NULL, val1 = NULL, answer2 = NULL, val2 = NULL, "
+                           "answer3 = NULL, val3 = NULL, answer4 = NULL, val4 = NULL;"));
+}
+
+void NavigationDAO::migrateProblemIds()
+{
+    // problem gets an INTEGER PRIMARY KEY equal to its old rowid, so the ids
+    // already held by problem_answer and problem_fts stay valid and no longer
+    // move on VACUUM. The answer columns emptied by migration 8 are dropped.
+    execSql("migrateProblemIds.createProblem",
+            QStringLiteral("CREATE TABLE problem_v9 ("
+                           "id   INTEGER PRIMARY KEY,"
+                           "text TEXT"
+                           ");"));
+    execSql("migrateProblemIds.copyProblem",
+            QStringLiteral("INSERT INTO problem_v9(id, text) SELECT rowid, text FROM problem;"));
+    execSql("migrateProblemIds.dropProblem", QStringLiteral("DROP TABLE problem;"));
+    execSql("migrateProblemIds.renameProblem",
+            QStringLiteral("ALTER TABLE problem_v9 RENAME TO problem;"));
+    createCounterTriggers("problem", "problem");
+
+    // With a real key to point at, answers cascade through a foreign key
+    // and the trigger from migration 8 goes away with the old table.
+    // Ordinals are renumbered from 0 so they match the answer positions.
+    execSql("migrateProblemIds.createAnswers",
+            QStringLiteral("CREATE TABLE problem_answer_v9 ("
+                           "problemId INTEGER NOT NULL"
+                           "  REFERENCES problem(id)"
+                           "  ON DELETE CASCADE,"
+                           "ordinal   INTEGER NOT NULL,"
+                           "text      TEXT NOT NULL,"
+                           "validity  INTEGER NOT NULL DEFAULT 0,"
+                           "PRIMARY KEY(problemId, ordinal)"
+                           ") WITHOUT ROWID;"));
+    execSql("migrateProblemIds.copyAnswers",
+            QStringLiteral("INSERT INTO problem_answer_v9(problemId, ordinal, text, validity) "
+                           "SELECT problemId, "
+                           "row_number() OVER (PARTITION BY problemId ORDER BY ordinal) - 1, "
+                           "text, validity "
+                           "FROM problem_answer WHERE problemId IN (SELECT id FROM problem);"));
+    execSql("migrateProblemIds.dropAnswers", QStringLiteral("DROP TABLE problem_answer;"));
+    execSql("migrateProblemIds.renameAnswers",
+            QStringLiteral("ALTER TABLE problem_answer_v9 RENAME TO problem_answer;"));
+    createCounterTriggers("problem_answer", "problem");
+
+    // History rows point at the problem and the chosen answer instead of
+    // copying their text. problemId used to be the position of the problem
+    // in the bank, so it is re-resolved from the question text.
+    execSql("migrateProblemIds.correctIndex",
+            QStringLiteral("ALTER TABLE question_history ADD COLUMN correctIndex INTEGER;"));
+    // problem.text has no index of its own; without this one every history
+    // row would scan the whole bank. It only lives for the resolve step.
+    execSql("migrateProblemIds.textIndex",
+            QStringLiteral("CREATE INDEX idx_problem_text_v9 ON problem(text, id);"));
+    execSql("migrateProblemIds.resolve",
+            QStringLiteral("UPDATE question_history SET problemId = "
+                           "(SELECT p.id FROM problem p WHERE p.text = question_history.question "
+                           "ORDER BY p.id LIMIT 1) "
+                           "WHERE question IS NOT NULL;"));
+    execSql("migrateProblemIds.dropTextIndex",
+            QStringLiteral("DROP INDEX idx_problem_text_v9;"));
+    execSql("migrateProblemIds.historyIndex",
+            QStringLiteral("CREATE INDEX IF NOT EXISTS idx_history_problem "
+                           "ON question_history(problemId) WHERE problemId IS NOT NULL;"));
+
+    // Only rows whose recorded options are exactly the problem's current
+    // answers can drop their copies; the rest keep their text. optionsJson
+    // was bound as a blob, hence the cast. The bank is read with the v9
+    // schema as it stands at this step, not through loadProblems().
+    QSqlQuery read(m_db);
+    read.setForwardOnly(true);
+    if (!read.exec(QStringLiteral("SELECT p.id, p.text, a.text, a.validity FROM problem p "
+                                  "LEFT JOIN problem_answer a ON a.problemId = p.id "
+                                  "ORDER BY p.id, a.ordinal;"))) {
+        throwSqlError("migrateProblemIds.read", read.lastError());
+    }
+
+    QVariantList correctIndexes, answerCounts, ids, texts, options;
+    qint64 currentId = 0;
+    QString currentText;
+    QVector<Answer> answers;
+    const auto finishProblem = [&] {
+        int correctIndex = -1;
+        for (int i = 0; i < answers.size() && correctIndex < 0; ++i) {
+            if (answers.at(i).validity())
+                correctIndex = i;
+        }
+        correctIndexes << (correctIndex >= 0 ? QVariant(correctIndex) : QVariant());
+        answerCounts   << answers.size();
+        ids            << currentId;
+        texts          << currentText;
+        options        << QString::fromUtf8(NavOptionsCodec::encodeJson(answers));
+        answers.clear();
+    };
+    while (read.next()) {
+        const qint64 id = read.value(0).toLongLong();
+        if (id != currentId) {
+            if (currentId != 0)
+                finishProblem();
+            currentId = id;
+            currentText = read.value(1).toString();
+        }
+        if (!read.value(2).isNull())
+            answers.push_back(Answer(read.value(2).toString(), read.value(3).toInt() != 0));
+    }
+    if (currentId != 0)
+        finishProblem();
+    read.finish();
+    if (ids.isEmpty())
+        return;
+
+    QSqlQuery q(m_db);
+    if (!q.prepare(QStringLiteral("UPDATE question_history SET "
+                                  "correctIndex = ?, "
+                                  "question = NULL, selectedAnswer = NULL, "
+                                  "correctAnswer = NULL, optionsJson = NULL "
+                                  "WHERE selectedIndex >= 0 AND selectedIndex < ? "
+                                  "AND problemId = ? AND question = ? AND CAST(optionsJson AS TEXT) = ?;"))) {
+        throwSqlError("migrateProblemIds.compact.prepare", q.lastError());
+    }
+    q.bindValue(0, correctIndexes);
+    q.bindValue(1, answerCounts);
+    q.bindValue(2, ids);
+    q.bindValue(3, texts);
+    q.bindValue(4, options);
+    NavQueryTimer timer("migrateProblemIds.compact", q);
+    if (!q.execBatch()) {
+        throwSqlError("migrateProblemIds.compact", q.lastError());
+    }
+}
+
+void NavigationDAO::migrateSessionKeys()
+{
+    // (userNickName, sessionTimestampMs) is the key from history to session.
+    // Session text used to be written without milliseconds and history text
+    // with them, so the integer copies of older rows can differ by the
+    // milliseconds; those history rows take the value of the session in the
+    // same second.
+    backfillEpochColumn("session", "timeStamp", "timeStampMs");
+    backfillEpochColumn("question_history", "sessionTimestamp", "sessionTimestampMs");
+
+    execSql("migrateSessionKeys.rekey",
+            QStringLiteral("UPDATE question_history SET sessionTimestampMs = coalesce("
+                           "(SELECT s.timeStampMs FROM session s "
+                           "WHERE s.userNickName = question_history.userNickName "
+                           "AND s.timeStampMs BETWEEN question_history.sessionTimestampMs / 1000 * 1000 "
+                           "AND question_history.sessionTimestampMs / 1000 * 1000 + 999 "
+                           "ORDER BY s.timeStampMs LIMIT 1), sessionTimestampMs) "
+                           "WHERE sessionTimestampMs IS NOT NULL AND NOT EXISTS "
+                           "(SELECT 1 FROM session s "
+                           "WHERE s.userNickName = question_history.userNickName "
+                           "AND s.timeStampMs = question_history.sessionTimestampMs);"));
+}
+
+void NavigationDAO::migrateDailyAttempts()
+{
+    // Attempts are stored as they are answered, before their session row.
+    // They now count towards user_daily_stats only once that row exists,
+    // added by the session's own trigger, so the statistics panel does not
+    // see the running session twice and attempts of a session that never
+    // arrived are not counted at all.
+    const QString day = QStringLiteral("date(%1 / 1000, 'unixepoch', 'localtime')");
+    const QString sessionAttempts = QStringLiteral(
+        "(SELECT count(*) FROM question_history h "
+        "WHERE h.userNickName = %1.userNickName AND h.sessionTimestampMs = %1.timeStampMs)");
+    const QString sessionCorrect = QStringLiteral(
+        "(SELECT coalesce(sum(h.wasCorrect <> 0), 0) FROM question_history h "
+        "WHERE h.userNickName = %1.userNickName AND h.sessionTimestampMs = %1.timeStampMs)");
+    const QString hasSession = QStringLiteral(
+        "EXISTS (SELECT 1 FROM session s "
+        "WHERE s.userNickName = %1.userNickName AND s.timeStampMs = %1.sessionTimestampMs)");
+
+    const QString addSession = QStringLiteral(
+        "INSERT INTO user_daily_stats(userNickName, day, sessions, hits, faults, lastSessionMs, "
+        "attempts, correctAttempts) "
+        "SELECT NEW.userNickName, %1, 1, coalesce(NEW.hits, 0), coalesce(NEW.faults, 0), NEW.timeStampMs, "
+        "%2, %3 "
+        "WHERE NEW.timeStampMs IS NOT NULL "
+        "ON CONFLICT(userNickName, day) DO UPDATE SET "
+        "sessions = sessions + 1, "
+        "hits = hits + excluded.hits, "
+        "faults = faults + excluded.faults, "
+        "attempts = attempts + excluded.attempts, "
+        "correctAttempts = correctAttempts + excluded.correctAttempts, "
+        "lastSessionMs = max(coalesce(lastSessionMs, 0), excluded.lastSessionMs);")
+        .arg(day.arg(QStringLiteral("NEW.timeStampMs")),
+             sessionAttempts.arg(QStringLiteral("NEW")),
+             sessionCorrect.arg(QStringLiteral("NEW")));
+    const QString removeSession = QStringLiteral(
+        "UPDATE user_daily_stats SET "
+        "sessions = sessions - 1, "
+        "hits = hits - coalesce(OLD.hits, 0), "
+        "faults = faults - coalesce(OLD.faults, 0), "
+        "attempts = attempts - %2, "
+        "correctAttempts = correctAttempts - %3 "
+        "WHERE OLD.timeStampMs IS NOT NULL "
+        "AND userNickName = OLD.userNickName AND day = %1;")
+        .arg(day.arg(QStringLiteral("OLD.timeStampMs")),
+             sessionAttempts.arg(QStringLiteral("OLD")),
+             sessionCorrect.arg(QStringLiteral("OLD")));
+    const QString addAttempt = QStringLiteral(
+        "INSERT INTO user_daily_stats(userNickName, day, attempts, correctAttempts) "
+        "VALUES(NEW.userNickName, %1, 1, NEW.wasCorrect <> 0) "
+        "ON CONFLICT(userNickName, day) DO UPDATE SET "
+        "attempts = attempts + 1, "
+        "correctAttempts = correctAttempts + excluded.correctAttempts;")
+        .arg(day.arg(QStringLiteral("NEW.sessionTimestampMs")));
+    const QString removeAttempt = QStringLiteral(
+        "UPDATE user_daily_stats SET "
+        "attempts = attempts - 1, "
+        "correctAttempts = correctAttempts - (OLD.wasCorrect <> 0) "
+        "WHERE userNickName = OLD.userNickName AND day = %1;")
+        .arg(day.arg(QStringLiteral("OLD.sessionTimestampMs")));
+
+    for (const char *trigger : {"trg_session_insert_daily", "trg_session_delete_daily",
+                                "trg_session_update_daily", "trg_history_insert_daily",
+                                "trg_history_delete_daily"}) {
+        execSql("migrateDailyAttempts.drop",
+                QStringLiteral("DROP TRIGGER IF EXISTS %1;").arg(QLatin1String(trigger)));
+    }
+    execSql("migrateDailyAttempts.sessionInsert",
+            QStringLiteral("CREATE TRIGGER trg_session_insert_daily "
+                           "AFTER INSERT ON session BEGIN %1 END;").arg(addSession));
+    execSql("migrateDailyAttempts.sessionDelete",
+            QStringLiteral("CREATE TRIGGER trg_session_delete_daily "
+                           "AFTER DELETE ON session BEGIN %1 END;").arg(removeSession));
+    execSql("migrateDailyAttempts.sessionUpdate",
+            QStringLiteral("CREATE TRIGGER trg_session_update_daily "
+                           "AFTER UPDATE OF userNickName, timeStampMs, hits, faults ON session "
+                           "BEGIN %1 %2 END;").arg(removeSession, addSession));
+    execSql("migrateDailyAttempts.historyInsert",
+            QStringLiteral("CREATE TRIGGER trg_history_insert_daily "
+                           "AFTER INSERT ON question_history "
+                           "WHEN NEW.sessionTimestampMs IS NOT NULL AND %2 "
+                           "BEGIN %1 END;").arg(addAttempt, hasSession.arg(QStringLiteral("NEW"))));
+    execSql("migrateDailyAttempts.historyDelete",
+            QStringLiteral("CREATE TRIGGER trg_history_delete_daily "
+                           "AFTER DELETE ON question_history "
+                           "WHEN OLD.sessionTimestampMs IS NOT NULL AND %2 "
+                           "BEGIN %1 END;").arg(removeAttempt, hasSession.arg(QStringLiteral("OLD"))));
+
+    // Recount with the new rule; days left with nothing go away.
+    execSql("migrateDailyAttempts.reset",
+            QStringLiteral("UPDATE user_daily_stats SET attempts = 0, correctAttempts = 0;"));
+    execSql("migrateDailyAttempts.seed",
+            QStringLiteral("INSERT INTO user_daily_stats(userNickName, day, attempts, correctAttempts) "
+                           "SELECT h.userNickName, %1, count(*), sum(h.wasCorrect <> 0) "
+                           "FROM question_history h JOIN session s "
+                           "ON s.userNickName = h.userNickName AND s.timeStampMs = h.sessionTimestampMs "
+                           "WHERE h.userNickName IN (SELECT nickName FROM user) "
+                           "GROUP BY 1, 2 "
+                           "ON CONFLICT(userNickName, day) DO UPDATE SET "
+                           "attempts = excluded.attempts, "
+                           "correctAttempts = excluded.correctAttempts;")
+                .arg(day.arg(QStringLiteral("h.sessionTimestampMs"))));
+    execSql("migrateDailyAttempts.prune",
+            QStringLiteral("DELETE FROM user_daily_stats WHERE sessions = 0 AND attempts = 0;"));
+}
+
+void NavigationDAO::migrateDropHistoryIndex()
+{
+    // idx_history_session repeated the first three primary-key columns, so
+    // it only cost writes; lookups use the primary key or
+    // idx_history_session_time.
+    execSql("migrateDropHistoryIndex",
+            QStringLiteral("DROP INDEX IF EXISTS idx_history_session;"));
+}
+
+int NavigationDAO::closeAbandonedSessions(const QDateTime &startedBefore)
+{
+    // Attempts whose session row never arrived (the app crashed or the
+    // session could not be saved) get one built from them, so the answers
+    // stay in the history and the statistics.
+    const char *sql =
+        "INSERT INTO session(userNickName, timeStamp, timeStampMs, hits, faults) "
+        "SELECT h.userNickName, min(h.sessionTimestamp), h.sessionTimestampMs, "
+        "sum(h.wasCorrect <> 0), sum(h.wasCorrect = 0) "
+        "FROM question_history h "
+        "WHERE h.sessionTimestampMs IS NOT NULL AND h.sessionTimestampMs < ? "
+        "AND h.userNickName IN (SELECT nickName FROM user) "
+        "AND NOT EXISTS (SELECT 1 FROM session s "
+        "WHERE s.userNickName = h.userNickName AND s.timeStampMs = h.sessionTimestampMs) "
+        "GROUP BY h.userNickName, h.sessionTimestampMs;";
+
+    int closed = 0;
+    writeTransaction("closeAbandonedSessions", [&] {
+        QSqlQuery &q = cachedQuery("closeAbandonedSessions", sql);
+        q.bindValue(0, startedBefore.toMSecsSinceEpoch());
+
+        NavQueryTimer timer("closeAbandonedSessions", q);
+        if (!q.exec()) {
+            throwSqlError("closeAbandonedSessions.exec", q.lastError());
+        }
+        closed = q.numRowsAffected();
+        q.finish();
+    });
+    return closed;
+}
+
+void NavigationDAO::backfillEpochColumn(const char *table, const char *textColumn, const char *msColumn)
+{
+    const QString tableName = QString::fromLatin1(table);
+    const QString textName  = QString::fromLatin1(textColumn);
+    const QString msName    = QString::fromLatin1(msColumn);
+
+    QVariantList rowIds;
+    QVariantList millis;
+    {
+        QSqlQuery read(m_db);
+        read.setForwardOnly(true);
+        if (!read.exec(QStringLiteral("SELECT rowid, %2 FROM %1 WHERE %2 IS NOT NULL AND %3 IS NULL;")
+                           .arg(tableName, textName, msName))) {
+            throwSqlError("backfillEpochColumn.read", read.lastError());
+        }
+        while (read.next()) {
+            const QDateTime ts = dateTimeFromDb(read.value(1).toString());
+            if (ts.isValid()) {
+                rowIds << read.value(0);
+                millis << ts.toMSecsSinceEpoch();
+            }
+        }
+    }
+
+    if (rowIds.isEmpty())
+        return;
+
+    QSqlQuery write(m_db);
+    if (!write.prepare(QStringLiteral("UPDATE %1 SET %2=? WHERE rowid=?;").arg(tableName, msName))) {
+        throwSqlError("backfillEpochColumn.prepare", write.lastError());
+    }
+    write.bindValue(0, millis);
+    write.bindValue(1, rowIds);
+    if (!write.execBatch()) {
+        throwSqlError("backfillEpochColumn.exec", write.lastError());
+    }
+}
+
+void NavigationDAO::execSql(const char *where, const QString &sql)
+{
+    QSqlQuery q(m_db);
+    NavQueryTimer timer(where, q);
+    if (!q.exec(sql)) {
+        throwSqlError(QString::fromLatin1(where), q.lastError());
+    }
+}
+
+QMap<QString, User> NavigationDAO::loadUsers(qint64 *lastSessionRowId)
+{
+    // Users and sessions are read from one snapshot so that the returned
+    // rowid watermark matches what was loaded.
+    const bool snapshot = m_db.transaction();
+
+    QMap<QString, User> result;
+    qint64 lastRowId = 0;
+    try {
+        result    = loadUserRows();
+        lastRowId = loadAllSessionsInto(result);
+    } catch (...) {
+        if (snapshot)
+            m_db.rollback();
+        throw;
+    }
+
+    if (snapshot)
+        m_db.commit();
+
+    if (lastSessionRowId)
+        *lastSessionRowId = lastRowId;
+    return result;
+}
+
+QMap<QString, User> NavigationDAO::loadUserRows()
 {
     QMap<QString, User> result;
 
     QSqlQuery q(m_db);
-    if (!q.exec(QStringLiteral("SELECT nickName, email, password, avatar, birthdate FROM user;"))) {
-        throwSqlError("loadUsers", q.lastError());
+    q.setForwardOnly(true);
+    NavQueryTimer timer("loadUserRows", q);
+    if (!q.exec(QStringLiteral("SELECT nickName, email, password, birthdate FROM user;"))) {
+        throwSqlError("loadUserRows", q.lastError());
     }
 
+    const NavRowDecoder cols = userColumns(q);
     while (q.next()) {
-        User u = buildUserFromQuery(q);
-        QVector<Session> sessions = loadSessionsFor(u.nickName());
-        u.setSessions(sessions);
+        timer.addRow();
+        User u = buildUserFromQuery(q, cols);
         result.insert(u.nickName(), u);
     }
-
     return result;
 }
 
+qint64 NavigationDAO::loadAllSessionsInto(QMap<QString, User> &users)
+{
+    // A single scan grouped by owner replaces one loadSessionsFor() per user.
+    const char *sql =
+        "SELECT userNickName, timeStamp, timeStampMs, hits, faults, rowid FROM session "
+        "ORDER BY userNickName, timeStampMs;";
+
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    NavQueryTimer timer("loadAllSessionsInto", q);
+    if (!q.exec(QString::fromUtf8(sql))) {
+        throwSqlError("loadAllSessionsInto", q.lastError());
+    }
+
+    const NavRowDecoder cols = sessionColumns(q);
+    QString currentNick;
+    auto owner = users.end();
+    qint64 lastRowId = 0;
+    while (q.next()) {
+        timer.addRow();
+        lastRowId = std::max(lastRowId, q.value(5).toLongLong());
+
+        const QString nick = q.value(0).toString();
+        if (owner == users.end() || nick != currentNick) {
+            currentNick = nick;
+            owner = users.find(nick);
+        }
+        if (owner != users.end()) {
+            owner.value().addSession(buildSessionFromQuery(q, cols));
+        }
+    }
+    return lastRowId;
+}
+
+QVector<NavigationDAO::SessionRow> NavigationDAO::loadSessionsAfter(qint64 rowId)
+{
+    const char *sql =
+        "SELECT userNickName, timeStamp, timeStampMs, hits, faults, rowid FROM session "
+        "WHERE rowid > ? ORDER BY rowid;";
+
+    QSqlQuery &q = cachedQuery("loadSessionsAfter", sql);
+    q.bindValue(0, rowId);
+    NavQueryTimer timer("loadSessionsAfter", q);
+    if (!q.exec()) {
+        throwSqlError("loadSessionsAfter", q.lastError());
+    }
+
+    const NavRowDecoder cols = sessionColumns(q);
+    QVector<SessionRow> rows;
+    while (q.next()) {
+        timer.addRow();
+        SessionRow row;
+        row.nickName = q.value(0).toString();
+        row.session  = buildSessionFromQuery(q, cols);
+        row.rowId    = q.value(5).toLongLong();
+        rows.push_back(row);
+    }
+    q.finish();
+    return rows;
+}
+
+qint64 NavigationDAO::dataVersion()
+{
+    QSqlQuery &q = cachedQuery("dataVersion", "PRAGMA data_version;");
+    NavQueryTimer timer("dataVersion", q);
+    if (!q.exec() || !q.next()) {
+        throwSqlError("dataVersion", q.lastError());
+    }
+    const qint64 version = q.value(0).toLongLong();
+    q.finish();
+    return version;
+}
+
+NavigationDAO::ChangeCounters NavigationDAO::changeCounters()
+{
+    QSqlQuery &q = cachedQuery("changeCounters",
+                               "SELECT tableName, version FROM change_counter;");
+    NavQueryTimer timer("changeCounters", q);
+    if (!q.exec()) {
+        throwSqlError("changeCounters", q.lastError());
+    }
+
+    ChangeCounters counters;
+    while (q.next()) {
+        timer.addRow();
+        const QString table = q.value(0).toString();
+        const qint64 version = q.value(1).toLongLong();
+        if (table == QLatin1String("user"))
+            counters.users = version;
+        else if (table == QLatin1String("session"))
+            counters.sessions = version;
+        else if (table == QLatin1String("problem"))
+            counters.problems = version;
+    }
+    q.finish();
+    return counters;
+}
+
 QVector<Problem> NavigationDAO::loadProblems()
 {
     QVector<Problem> result;
 
+    // Answers arrive right after their problem, in order.
     QSqlQuery q(m_db);
-    if (!q.exec(QStringLiteral("SELECT * FROM problem;"))) {
+    q.setForwardOnly(true);
+    NavQueryTimer timer("loadProblems", q);
+    if (!q.exec(QStringLiteral("SELECT p.id, p.text, a.text, a.validity "
+                               "FROM problem p "
+                               "LEFT JOIN problem_answer a ON a.problemId = p.id "
+                               "ORDER BY p.id, a.ordinal;"))) {
         throwSqlError("loadProblems", q.lastError());
     }
 
+    qint64 currentId = 0;
+    QString text;
+    QVector<Answer> answers;
+    const auto finishProblem = [&] {
+        Problem problem(text, answers);
+        problem.setId(currentId);
+        result.push_back(std::move(problem));
+        answers.clear();
+    };
+
     while (q.next()) {
-        result.push_back(buildProblemFromQuery(q));
+        timer.addRow();
+        const qint64 id = q.value(0).toLongLong();
+        if (id != currentId) {
+            if (currentId != 0) {
+                finishProblem();
+            }
+            currentId = id;
+            text = q.value(1).toString();
+        }
+        if (!q.value(2).isNull()) {
+            answers.push_back(Answer(q.value(2).toString(), q.value(3).toInt() != 0));
+        }
+    }
+    if (currentId != 0) {
+        finishProblem();
     }
     return result;
 }
@@ -151,29 +1105,31 @@ void NavigationDAO::saveUser(User &user)
 {
     if (user.insertedInDb()) {
         updateUser(user);
+        user.clearDirtyFields();
         return;
     }
 
     const char *sql =
-        "INSERT INTO user(nickName, password, email, birthdate, avatar) "
-        "VALUES(?,?,?,?,?);";
-
-    QSqlQuery q(m_db);
-    if (!q.prepare(QString::fromUtf8(sql))) {
-        throwSqlError("saveUser.prepare", q.lastError());
-    }
+        "INSERT INTO user(nickName, password, email, birthdate) "
+        "VALUES(?,?,?,?);";
 
+    QSqlQuery &q = cachedQuery("saveUser", sql);
     q.bindValue(0, user.nickName());
     q.bindValue(1, user.password());
     q.bindValue(2, user.email());
     q.bindValue(3, dateToDb(user.birthdate()));
-    q.bindValue(4, imageToPng(user.avatar()));
 
-    if (!q.exec()) {
-        throwSqlError("saveUser.exec", q.lastError());
+    {
+        NavQueryTimer timer("saveUser", q);
+        if (!q.exec()) {
+            throwSqlError("saveUser.exec", q.lastError());
+        }
+        q.finish();
     }
 
     user.setInsertedInDb(true);
+    user.clearDirtyFields();
+    saveAvatar(user.nickName(), user.avatar());
 
     for (const Session &s : user.sessions()) {
         addSession(user.nickName(), s);
@@ -182,35 +1138,119 @@ void NavigationDAO::saveUser(User &user)
 
 void NavigationDAO::updateUser(const User &user)
 {
-    const char *sql =
-        "UPDATE user SET email=?, password=?, avatar=?, birthdate=? "
-        "WHERE nickName=?;";
+    const unsigned dirty = user.dirtyFields();
+    const unsigned columns = dirty & ~unsigned(User::AvatarField);
+
+    if (columns != 0) {
+        // One prepared statement per combination of changed columns.
+        QByteArray sql = "UPDATE user SET ";
+        QVariantList values;
+        if (columns & User::EmailField) {
+            sql += "email=?, ";
+            values << user.email();
+        }
+        if (columns & User::PasswordField) {
+            sql += "password=?, ";
+            values << user.password();
+        }
+        if (columns & User::BirthdateField) {
+            sql += "birthdate=?, ";
+            values << dateToDb(user.birthdate());
+        }
+        sql.chop(2);
+        sql += " WHERE nickName=?;";
+        values << user.nickName();
+
+        const QByteArray key = "updateUser." + QByteArray::number(columns);
+        QSqlQuery &q = cachedQuery(key.constData(), sql.constData());
+        for (int i = 0; i < values.size(); ++i) {
+            q.bindValue(i, values.at(i));
+        }
 
-    QSqlQuery q(m_db);
-    if (!q.prepare(QString::fromUtf8(sql))) {
-        throwSqlError("updateUser.prepare", q.lastError());
+        NavQueryTimer timer("updateUser", q);
+        if (!q.exec()) {
+            throwSqlError("updateUser.exec", q.lastError());
+        }
+        q.finish();
     }
 
-    q.bindValue(0, user.email());
-    q.bindValue(1, user.password());
-    q.bindValue(2, imageToPng(user.avatar()));
-    q.bindValue(3, dateToDb(user.birthdate()));
-    q.bindValue(4, user.nickName());
+    // The PNG is only re-encoded when a new picture was set.
+    if (dirty & User::AvatarField) {
+        saveAvatar(user.nickName(), user.avatar());
+    }
+}
+
+QImage NavigationDAO::loadAvatar(const QString &nickName)
+{
+    QSqlQuery &q = cachedQuery("loadAvatar", "SELECT png FROM user_avatar WHERE nickName=?;");
+    q.bindValue(0, nickName);
+
+    NavQueryTimer timer("loadAvatar", q);
+    if (!q.exec()) {
+        throwSqlError("loadAvatar.exec", q.lastError());
+    }
+
+    QImage avatar;
+    if (q.next()) {
+        avatar = imageFromPng(q.value(0).toByteArray());
+    }
+    q.finish();
+    return avatar;
+}
+
+QImage NavigationDAO::readAvatar(const QString &dbFilePath, const QString &nickName)
+{
+    // Avatar handles may be resolved on any thread, after the DAO that built
+    // the user is gone, so they read through the calling thread's connection.
+    QImage avatar;
+    QSqlDatabase db = NavConnectionManager::connection(dbFilePath);
+    if (!db.isOpen())
+        return avatar;
+
+    QSqlQuery q(db);
+    q.prepare(QStringLiteral("SELECT png FROM user_avatar WHERE nickName=?;"));
+    q.bindValue(0, nickName);
+    NavQueryTimer timer("readAvatar", q);
+    if (q.exec() && q.next()) {
+        avatar.loadFromData(q.value(0).toByteArray(), "PNG");
+    }
+    return avatar;
+}
+
+void NavigationDAO::saveAvatar(const QString &nickName, const QImage &avatar)
+{
+    if (avatar.isNull()) {
+        QSqlQuery &q = cachedQuery("saveAvatar.delete", "DELETE FROM user_avatar WHERE nickName=?;");
+        q.bindValue(0, nickName);
+        NavQueryTimer timer("saveAvatar.delete", q);
+        if (!q.exec()) {
+            throwSqlError("saveAvatar.delete", q.lastError());
+        }
+        q.finish();
+        return;
+    }
 
+    QSqlQuery &q = cachedQuery("saveAvatar",
+                               "INSERT OR REPLACE INTO user_avatar(nickName, png) VALUES(?,?);");
+    q.bindValue(0, nickName);
+    q.bindValue(1, imageToPng(avatar));
+    NavQueryTimer timer("saveAvatar", q);
     if (!q.exec()) {
-        throwSqlError("updateUser.exec", q.lastError());
+        throwSqlError("saveAvatar.exec", q.lastError());
     }
+    q.finish();
 }
 
 void NavigationDAO::deleteUser(const QString &nickName)
 {
-    QSqlQuery q(m_db);
-    q.prepare(QStringLiteral("DELETE FROM user WHERE nickName=?;"));
+    QSqlQuery &q = cachedQuery("deleteUser", "DELETE FROM user WHERE nickName=?;");
     q.bindValue(0, nickName);
 
+    NavQueryTimer timer("deleteUser", q);
     if (!q.exec()) {
         throwSqlError("deleteUser", q.lastError());
     }
+    q.finish();
 }
 
 QVector<Session> NavigationDAO::loadSessionsFor(const QString &nickName)
@@ -218,129 +1258,459 @@ QVector<Session> NavigationDAO::loadSessionsFor(const QString &nickName)
     QVector<Session> res;
 
     const char *sql =
-        "SELECT timeStamp, hits, faults FROM session "
-        "WHERE userNickName=?;";
+        "SELECT timeStamp, timeStampMs, hits, faults FROM session "
+        "WHERE userNickName=? ORDER BY timeStampMs;";
 
-    QSqlQuery q(m_db);
-    if (!q.prepare(QString::fromUtf8(sql))) {
-        throwSqlError("loadSessionsFor.prepare", q.lastError());
-    }
+    QSqlQuery &q = cachedQuery("loadSessionsFor", sql);
     q.bindValue(0, nickName);
 
+    NavQueryTimer timer("loadSessionsFor", q);
     if (!q.exec()) {
         throwSqlError("loadSessionsFor.exec", q.lastError());
     }
 
+    const NavRowDecoder cols = sessionColumns(q);
     while (q.next()) {
-        res.push_back(buildSessionFromQuery(q));
+        timer.addRow();
+        res.push_back(buildSessionFromQuery(q, cols));
     }
+    q.finish();
     return res;
 }
 
-void NavigationDAO::addSession(const QString &nickName, const Session &session)
+bool NavigationDAO::hasSession(const QString &nickName, const QDateTime &timeStamp)
 {
     const char *sql =
-        "INSERT INTO session(userNickName, timeStamp, hits, faults) "
-        "VALUES(?,?,?,?);";
+        "SELECT 1 FROM session WHERE userNickName=? AND timeStampMs=? LIMIT 1;";
 
-    QSqlQuery q(m_db);
-    if (!q.prepare(QString::fromUtf8(sql))) {
-        throwSqlError("addSession.prepare", q.lastError());
+    QSqlQuery &q = cachedQuery("hasSession", sql);
+    q.bindValue(0, nickName);
+    q.bindValue(1, timeStamp.toMSecsSinceEpoch());
+    NavQueryTimer timer("hasSession", q);
+    if (!q.exec()) {
+        throwSqlError("hasSession.exec", q.lastError());
+    }
+    const bool found = q.next();
+    q.finish();
+    return found;
+}
+
+NavigationDAO::SessionPage NavigationDAO::loadSessionPage(const QString &nickName,
+                                                          const SessionKey &after,
+                                                          int limit,
+                                                          const QDateTime &from,
+                                                          const QDateTime &to,
+                                                          int offset)
+{
+    // Keyset pagination on (timeStampMs, rowid) walks idx_session_user_time
+    // backwards; one extra row is fetched to learn whether more follow.
+    const char *sql =
+        "SELECT timeStamp, timeStampMs, hits, faults, rowid FROM session "
+        "WHERE userNickName=? AND timeStampMs >= ? AND timeStampMs < ? "
+        "AND (timeStampMs < ? OR (timeStampMs = ? AND rowid < ?)) "
+        "ORDER BY timeStampMs DESC, rowid DESC LIMIT ? OFFSET ?;";
+
+    QSqlQuery &q = cachedQuery("loadSessionPage", sql);
+    q.bindValue(0, nickName);
+    q.bindValue(1, from.isValid() ? from.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min());
+    q.bindValue(2, to.isValid() ? to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max());
+    q.bindValue(3, after.timeStampMs);
+    q.bindValue(4, after.timeStampMs);
+    q.bindValue(5, after.rowId);
+    q.bindValue(6, std::max(limit, 0) + 1);
+    q.bindValue(7, std::max(offset, 0));
+
+    NavQueryTimer timer("loadSessionPage", q);
+    if (!q.exec()) {
+        throwSqlError("loadSessionPage.exec", q.lastError());
+    }
+
+    SessionPage page;
+    page.next = after;
+    page.sessions.reserve(std::max(limit, 0));
+
+    const NavRowDecoder cols = sessionColumns(q);
+    while (q.next()) {
+        timer.addRow();
+        if (page.sessions.size() == limit) {
+            page.hasMore = true;
+            break;
+        }
+        page.sessions.push_back(buildSessionFromQuery(q, cols));
+        page.next.timeStampMs = q.value(1).toLongLong();
+        page.next.rowId       = q.value(4).toLongLong();
+    }
+    q.finish();
+    return page;
+}
+
+NavigationDAO::SessionTotals NavigationDAO::sessionTotals(const QString &nickName,
+                                                          const QDateTime &from,
+                                                          const QDateTime &to)
+{
+    const char *sql =
+        "SELECT count(*), total(hits), total(faults) FROM session "
+        "WHERE userNickName=? AND timeStampMs >= ? AND timeStampMs < ?;";
+
+    QSqlQuery &q = cachedQuery("sessionTotals", sql);
+    q.bindValue(0, nickName);
+    q.bindValue(1, from.isValid() ? from.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min());
+    q.bindValue(2, to.isValid() ? to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max());
+
+    NavQueryTimer timer("sessionTotals", q);
+    if (!q.exec() || !q.next()) {
+        throwSqlError("sessionTotals.exec", q.lastError());
+    }
+
+    SessionTotals totals;
+    totals.sessions = q.value(0).toLongLong();
+    totals.hits     = q.value(1).toLongLong();
+    totals.faults   = q.value(2).toLongLong();
+    q.finish();
+    return totals;
+}
+
+QVector<NavigationDAO::DailyStats> NavigationDAO::loadDailyStats(const QString &nickName,
+                                                                  const QDate &from,
+                                                                  const QDate &to)
+{
+    // ISO dates compare correctly as text, so the range is a primary-key scan.
+    const char *sql =
+        "SELECT day, sessions, hits, faults, attempts, correctAttempts, lastSessionMs "
+        "FROM user_daily_stats "
+        "WHERE userNickName=? AND day >= ? AND day <= ? "
+        "AND (sessions > 0 OR attempts > 0) "
+        "ORDER BY day;";
+
+    QSqlQuery &q = cachedQuery("loadDailyStats", sql);
+    q.bindValue(0, nickName);
+    q.bindValue(1, from.isValid() ? dateToDb(from) : QStringLiteral("0000-00-00"));
+    q.bindValue(2, to.isValid() ? dateToDb(to) : QStringLiteral("9999-99-99"));
+
+    NavQueryTimer timer("loadDailyStats", q);
+    if (!q.exec()) {
+        throwSqlError("loadDailyStats.exec", q.lastError());
+    }
+
+    QVector<DailyStats> days;
+    while (q.next()) {
+        timer.addRow();
+        DailyStats d;
+        d.day             = dateFromDb(q.value(0).toString());
+        d.sessions        = q.value(1).toLongLong();
+        d.hits            = q.value(2).toLongLong();
+        d.faults          = q.value(3).toLongLong();
+        d.attempts        = q.value(4).toLongLong();
+        d.correctAttempts = q.value(5).toLongLong();
+        if (!q.value(6).isNull())
+            d.lastSession = QDateTime::fromMSecsSinceEpoch(q.value(6).toLongLong());
+        days.push_back(d);
     }
+    q.finish();
+    return days;
+}
 
+qint64 NavigationDAO::addSession(const QString &nickName, const Session &session)
+{
+    const char *sql =
+        "INSERT INTO session(userNickName, timeStamp, timeStampMs, hits, faults) "
+        "VALUES(?,?,?,?,?);";
+
+    QSqlQuery &q = cachedQuery("addSession", sql);
     q.bindValue(0, nickName);
     q.bindValue(1, dateTimeToDb(session.timeStamp()));
-    q.bindValue(2, session.hits());
-    q.bindValue(3, session.faults());
+    q.bindValue(2, session.timeStamp().toMSecsSinceEpoch());
+    q.bindValue(3, session.hits());
+    q.bindValue(4, session.faults());
 
+    NavQueryTimer timer("addSession", q);
     if (!q.exec()) {
         throwSqlError("addSession.exec", q.lastError());
     }
+    const qint64 rowId = q.lastInsertId().toLongLong();
+    q.finish();
+    return rowId;
 }
 
-void NavigationDAO::replaceAllProblems(const QVector<Problem> &problems)
+void NavigationDAO::replaceAllProblems(const QVector<Problem> &problems,
+                                       const ProgressCallback &progress)
 {
-    {
-        QSqlQuery del(m_db);
-        if (!del.exec(QStringLiteral("DELETE FROM problem;"))) {
-            throwSqlError("replaceAllProblems.DELETE", del.lastError());
+    // Rows are bound column-wise and sent in chunks so a large bank is one
+    // transaction (one fsync) and progress can be reported between chunks.
+    constexpr qsizetype kBatchSize = 1000;
+
+    // Ids are assigned here so the answers can reference them in the same
+    // batch. A problem whose text and answers are unchanged keeps its id, so
+    // the history rows pointing at it stay valid.
+    const char *problemSql =
+        "INSERT INTO problem(id, text) VALUES(?,?);";
+    const char *answerSql =
+        "INSERT INTO problem_answer(problemId, ordinal, text, validity) VALUES(?,?,?,?);";
+
+    const auto storedAnswers = [](const Problem &p) {
+        QVector<Answer> answers;
+        for (const Answer &a : p.answers()) {
+            if (!a.text().isEmpty())
+                answers.push_back(a);
+        }
+        return answers;
+    };
+    const auto contentKey = [&](const Problem &p) {
+        return p.text() + QChar(0x1f) + QString::fromUtf8(NavOptionsCodec::encodeJson(storedAnswers(p)));
+    };
+
+    writeTransaction("replaceAllProblems", [&] {
+        QHash<QString, QVector<qint64>> existingIds;
+        QVector<Problem> existing = loadProblems();
+        qint64 nextId = 1;
+        for (const Problem &p : existing) {
+            existingIds[contentKey(p)].push_back(p.id());
+            nextId = qMax(nextId, p.id() + 1);
+        }
+
+        QVector<qint64> ids;
+        ids.reserve(problems.size());
+        for (const Problem &p : problems) {
+            auto it = existingIds.find(contentKey(p));
+            if (it != existingIds.end() && !it->isEmpty()) {
+                ids.push_back(it->takeFirst());
+            } else {
+                ids.push_back(nextId++);
+            }
+        }
+
+        QVector<Problem> removed;
+        for (const Problem &p : existing) {
+            const QVector<qint64> &left = existingIds.value(contentKey(p));
+            if (left.contains(p.id()))
+                removed.push_back(p);
+        }
+        detachHistory(removed);
+
+        execSql("replaceAllProblems.deleteAnswers", QStringLiteral("DELETE FROM problem_answer;"));
+        execSql("replaceAllProblems.DELETE", QStringLiteral("DELETE FROM problem;"));
+
+        QSqlQuery &problemQuery = cachedQuery("replaceAllProblems", problemSql);
+        QSqlQuery &answerQuery  = cachedQuery("replaceAllProblems.answers", answerSql);
+        const qsizetype total = problems.size();
+        if (progress) {
+            progress(0, total);
+        }
+
+        for (qsizetype first = 0; first < total; first += kBatchSize) {
+            const qsizetype last = qMin(first + kBatchSize, total);
+
+            QVariantList problemIds, texts;
+            QVariantList answerProblem, answerOrdinal, answerText, answerValidity;
+            problemIds.reserve(last - first);
+            texts.reserve(last - first);
+
+            for (qsizetype i = first; i < last; ++i) {
+                const Problem &p = problems.at(i);
+                const qint64 id = ids.at(i);
+                problemIds << id;
+                texts << p.text();
+
+                // Ordinals are the positions the answers load back at.
+                const QVector<Answer> ans = storedAnswers(p);
+                for (int a = 0; a < ans.size(); ++a) {
+                    answerProblem  << id;
+                    answerOrdinal  << a;
+                    answerText     << ans.at(a).text();
+                    answerValidity << (ans.at(a).validity() ? 1 : 0);
+                }
+            }
+
+            problemQuery.bindValue(0, problemIds);
+            problemQuery.bindValue(1, texts);
+            {
+                NavQueryTimer timer("replaceAllProblems", problemQuery);
+                if (!problemQuery.execBatch()) {
+                    throwSqlError("replaceAllProblems.exec", problemQuery.lastError());
+                }
+                problemQuery.finish();
+            }
+
+            if (!answerProblem.isEmpty()) {
+                answerQuery.bindValue(0, answerProblem);
+                answerQuery.bindValue(1, answerOrdinal);
+                answerQuery.bindValue(2, answerText);
+                answerQuery.bindValue(3, answerValidity);
+
+                NavQueryTimer timer("replaceAllProblems.answers", answerQuery);
+                if (!answerQuery.execBatch()) {
+                    throwSqlError("replaceAllProblems.answers", answerQuery.lastError());
+                }
+                answerQuery.finish();
+            }
+
+            if (progress) {
+                progress(last, total);
+            }
         }
-    }
+
+        if (m_hasProblemSearch) {
+            rebuildProblemSearchIndex();
+        }
+    });
+}
+
+void NavigationDAO::detachHistory(const QVector<Problem> &removed)
+{
+    // History that refers to a problem about to be deleted gets its text
+    // back, so past sessions still read the same after the import.
+    if (removed.isEmpty())
+        return;
 
     const char *sql =
-        "INSERT INTO problem(text, answer1, val1, answer2, val2, "
-        "answer3, val3, answer4, val4) "
-        "VALUES(?,?,?,?,?,?,?,?,?);";
+        "UPDATE question_history SET "
+        "question = coalesce(question, ?), "
+        "optionsJson = coalesce(optionsJson, ?), "
+        "selectedAnswer = coalesce(selectedAnswer, (SELECT a.text FROM problem_answer a "
+        "WHERE a.problemId = question_history.problemId "
+        "AND a.ordinal = question_history.selectedIndex)), "
+        "correctAnswer = coalesce(correctAnswer, (SELECT a.text FROM problem_answer a "
+        "WHERE a.problemId = question_history.problemId "
+        "AND a.ordinal = question_history.correctIndex)), "
+        "problemId = NULL "
+        "WHERE problemId = ?;";
+
+    QVariantList texts, options, ids;
+    for (const Problem &p : removed) {
+        texts   << p.text();
+        options << NavOptionsCodec::encode(p.answers());
+        ids     << p.id();
+    }
 
-    QSqlQuery q(m_db);
-    if (!q.prepare(QString::fromUtf8(sql))) {
-        throwSqlError("replaceAllProblems.prepare", q.lastError());
+    QSqlQuery &q = cachedQuery("detachHistory", sql);
+    q.bindValue(0, texts);
+    q.bindValue(1, options);
+    q.bindValue(2, ids);
+
+    NavQueryTimer timer("detachHistory", q);
+    if (!q.execBatch()) {
+        throwSqlError("detachHistory.exec", q.lastError());
     }
+    q.finish();
+}
 
-    for (const Problem &p : problems) {
-        QVector<Answer> ans = p.answers();
-        while (ans.size() < 4) {
-            ans.push_back(Answer(QString(), false));
+QVector<qint64> NavigationDAO::searchProblems(const QString &query, int limit)
+{
+    // Free text is reduced to words so that user input can never be parsed
+    // as FTS5 syntax; the last word is a prefix to match while typing.
+    static const QRegularExpression separators(QStringLiteral("[^\\w]+"),
+                                               QRegularExpression::UseUnicodePropertiesOption);
+    const QStringList words = query.split(separators, Qt::SkipEmptyParts);
+
+    QVector<qint64> ids;
+    if (words.isEmpty() || limit <= 0)
+        return ids;
+
+    if (m_hasProblemSearch) {
+        QStringList terms;
+        for (const QString &word : words) {
+            terms << QLatin1Char('"') + word + QLatin1Char('"');
         }
+        terms.last() += QLatin1Char('*');
 
-        q.bindValue(0, p.text());
-        q.bindValue(1, ans[0].text());
-        q.bindValue(2, boolToDb(ans[0].validity()));
-        q.bindValue(3, ans[1].text());
-        q.bindValue(4, boolToDb(ans[1].validity()));
-        q.bindValue(5, ans[2].text());
-        q.bindValue(6, boolToDb(ans[2].validity()));
-        q.bindValue(7, ans[3].text());
-        q.bindValue(8, boolToDb(ans[3].validity()));
+        // Matches in the statement weigh twice as much as in the answers.
+        const char *sql =
+            "SELECT rowid FROM problem_fts WHERE problem_fts MATCH ? "
+            "ORDER BY bm25(problem_fts, 2.0, 1.0) LIMIT ?;";
 
+        QSqlQuery &q = cachedQuery("searchProblems", sql);
+        q.bindValue(0, terms.join(QLatin1Char(' ')));
+        q.bindValue(1, limit);
+        NavQueryTimer timer("searchProblems", q);
         if (!q.exec()) {
-            throwSqlError("replaceAllProblems.exec", q.lastError());
+            throwSqlError("searchProblems.exec", q.lastError());
+        }
+        while (q.next()) {
+            timer.addRow();
+            ids.push_back(q.value(0).toLongLong());
         }
         q.finish();
+        return ids;
+    }
+
+    QStringList clauses;
+    for (int i = 0; i < words.size(); ++i) {
+        clauses << QStringLiteral("(coalesce(text, '') || ' ' || "
+                                  "coalesce((SELECT group_concat(a.text, ' ') FROM problem_answer a "
+                                  "WHERE a.problemId = problem.id), '')) LIKE ? ESCAPE '\\'");
+    }
+
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    if (!q.prepare(QStringLiteral("SELECT id FROM problem WHERE %1 ORDER BY id LIMIT ?;")
+                       .arg(clauses.join(QStringLiteral(" AND "))))) {
+        throwSqlError("searchProblems.prepare", q.lastError());
+    }
+    for (int i = 0; i < words.size(); ++i) {
+        QString pattern = words.at(i);
+        pattern.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+               .replace(QLatin1Char('%'), QLatin1String("\\%"))
+               .replace(QLatin1Char('_'), QLatin1String("\\_"));
+        q.bindValue(i, QLatin1Char('%') + pattern + QLatin1Char('%'));
+    }
+    q.bindValue(words.size(), limit);
+    NavQueryTimer timer("searchProblems.like", q);
+    if (!q.exec()) {
+        throwSqlError("searchProblems.like", q.lastError());
+    }
+    while (q.next()) {
+        timer.addRow();
+        ids.push_back(q.value(0).toLongLong());
     }
+    return ids;
 }
 
-User NavigationDAO::buildUserFromQuery(QSqlQuery &q)
+QSqlQuery &NavigationDAO::cachedQuery(const char *key, const char *sql)
 {
-    const QString nick  = q.value(QStringLiteral("nickName")).toString();
-    const QString email = q.value(QStringLiteral("email")).toString();
-    const QString pass  = q.value(QStringLiteral("password")).toString();
-    const QByteArray avatarBytes = q.value(QStringLiteral("avatar")).toByteArray();
-    const QString birthStr = q.value(QStringLiteral("birthdate")).toString();
+    const QString name = QString::fromLatin1(key);
+    auto it = m_statements.find(name);
+    if (it != m_statements.end()) {
+        ++m_statementStats.hits;
+        return *it->second;
+    }
+
+    ++m_statementStats.misses;
+    auto q = std::make_unique<QSqlQuery>(m_db);
+    q->setForwardOnly(true);
+    if (!q->prepare(QString::fromUtf8(sql))) {
+        throwSqlError(name + QStringLiteral(".prepare"), q->lastError());
+    }
+    return *m_statements.emplace(name, std::move(q)).first->second;
+}
+
+User NavigationDAO::buildUserFromQuery(QSqlQuery &q, const NavRowDecoder &cols)
+{
+    const QString nick  = cols.value(q, UserNickName).toString();
+    const QString email = cols.value(q, UserEmail).toString();
+    const QString pass  = cols.value(q, UserPassword).toString();
+    const QString birthStr = cols.value(q, UserBirthdate).toString();
 
-    QImage avatar = imageFromPng(avatarBytes);
     QDate  birth  = dateFromDb(birthStr);
 
-    User u(nick, email, pass, avatar, birth);
+    User u(nick, email, pass, QImage(), birth);
+    u.setAvatarLoader([path = m_dbFilePath, nick] { return readAvatar(path, nick); });
     u.setInsertedInDb(true);
     return u;
 }
 
-Session NavigationDAO::buildSessionFromQuery(QSqlQuery &q)
+Session NavigationDAO::buildSessionFromQuery(QSqlQuery &q, const NavRowDecoder &cols)
 {
-    const QString tsStr = q.value(QStringLiteral("timeStamp")).toString();
-    const int hits      = q.value(QStringLiteral("hits")).toInt();
-    const int faults    = q.value(QStringLiteral("faults")).toInt();
-
-    QDateTime ts = dateTimeFromDb(tsStr);
+    const QVariant tsMs = cols.value(q, SessionTimeStampMs);
+    const int hits      = cols.value(q, SessionHits).toInt();
+    const int faults    = cols.value(q, SessionFaults).toInt();
+
+    // Rows written by older builds may still lack the integer column.
+    QDateTime ts = tsMs.isNull()
+        ? dateTimeFromDb(cols.value(q, SessionTimeStamp).toString())
+        : QDateTime::fromMSecsSinceEpoch(tsMs.toLongLong());
     return Session(ts, hits, faults);
 }
 
-Problem NavigationDAO::buildProblemFromQuery(QSqlQuery &q)
-{
-    const QString text = q.value(QStringLiteral("text")).toString();
-
-    QVector<Answer> ans;
-    ans.reserve(4);
-    for (int i = 1; i <= 4; ++i) {
-        QString a = q.value(QString("answer%1").arg(i)).toString();
-        QString v = q.value(QString("val%1").arg(i)).toString();
-        ans.push_back(Answer(a, boolFromDb(v)));
-    }
-
-    return Problem(text, ans);
-}
-
 QByteArray NavigationDAO::imageToPng(const QImage &img)
 {
     if (img.isNull())
@@ -372,26 +1742,20 @@ QDate NavigationDAO::dateFromDb(const QString &s) const
 
 QString NavigationDAO::dateTimeToDb(const QDateTime &dt) const
 {
-    return dt.toString(Qt::ISODate);
+    // Same format as question_history.sessionTimestamp.
+    return dt.toString(Qt::ISODateWithMs);
 }
 
 QDateTime NavigationDAO::dateTimeFromDb(const QString &s) const
 {
-    return QDateTime::fromString(s, Qt::ISODate);
-}
-
-QString NavigationDAO::boolToDb(bool v) const
-{
-    return v ? QStringLiteral("1") : QStringLiteral("0");
-}
-
-bool NavigationDAO::boolFromDb(const QString &s) const
-{
-    return (s == QLatin1String("1"));
+    return QDateTime::fromString(s, Qt::ISODateWithMs);
 }
 
 [[noreturn]] void NavigationDAO::throwSqlError(const QString &where, const QSqlError &err) const
 {
-    throw NavDAOException(QStringLiteral("NavigationDAO [%1]: %2")
-                          .arg(where, err.text()));
+    const QString message = QStringLiteral("NavigationDAO [%1]: %2").arg(where, err.text());
+    if (isBusyError(err)) {
+        throw NavDAOBusyException(message);
+    }
+    throw NavDAOException(message);
 }
@@ -0,0 +1,113 @@
+#include "navloadbench.h"
+#include "navcommandline.h"
+#include "navquerystats.h"
+#include "navsyntheticdataset.h"
+
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <cstdlib>
+
+namespace {
+constexpr char kArguments[] = "[users...]";
+constexpr int kSessionsPerUser = 50;
+
+struct Result {
+    qint64  users      = 0;
+    qint64  sessions   = 0;
+    quint64 statements = 0;
+    qint64  elapsedMs  = 0;
+};
+
+// Statements recorded by NavQueryTimer since the last reset.
+quint64 statementCount()
+{
+    quint64 calls = 0;
+    for (const NavQueryStats::Entry &entry : NavQueryStats::instance().snapshot())
+        calls += entry.calls;
+    return calls;
+}
+
+template <typename Load>
+Result measure(Load &&load)
+{
+    NavQueryStats::instance().reset();
+    QElapsedTimer timer;
+    timer.start();
+    const QMap<QString, User> users = load();
+
+    Result result;
+    result.elapsedMs  = timer.elapsed();
+    result.statements = statementCount();
+    result.users      = users.size();
+    for (const User &user : users)
+        result.sessions += user.sessions().size();
+    return result;
+}
+
+void report(const char *name, const Result &r)
+{
+    NavCommandLine::out() << "  " << name << ": " << r.users << " users, " << r.sessions << " sessions, "
+                          << r.statements << " statements, " << r.elapsedMs << " ms\n";
+}
+}
+
+int NavLoadBench::run(const QStringList &arguments)
+{
+    QVector<int> counts;
+    for (qsizetype i = 2; i < arguments.size(); ++i) {
+        bool ok = false;
+        const int users = arguments.at(i).toInt(&ok);
+        if (!ok || users <= 0)
+            return NavCommandLine::usage(kFlag, kArguments);
+        counts.push_back(users);
+    }
+    if (counts.isEmpty())
+        counts = {100, 1000, 10000};
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        NavCommandLine::err() << dir.errorString() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        for (const int users : std::as_const(counts)) {
+            const QString dbFilePath = dir.filePath(QStringLiteral("users-%1.sqlite").arg(users));
+            {
+                NavigationDAO writer(dbFilePath);
+                NavSyntheticDataset::Options options;
+                options.users              = users;
+                options.sessionsPerUser    = kSessionsPerUser;
+                options.attemptsPerSession = 0;
+                options.problems           = 0;
+                NavSyntheticDataset::generate(writer, options);
+            }
+
+            NavCommandLine::out() << users << " users x " << kSessionsPerUser << " sessions\n";
+            NavCommandLine::out().flush();
+
+            // A fresh DAO, as Navigation builds one at start-up; the grouped
+            // load goes first so the page cache does not favour it.
+            NavigationDAO reader(dbFilePath);
+            const Result grouped = measure([&] { return reader.loadUsers(); });
+            const Result perUser = measure([&] {
+                QMap<QString, User> loaded = reader.loadUserRows();
+                for (auto it = loaded.begin(); it != loaded.end(); ++it)
+                    it.value().setSessions(reader.loadSessionsFor(it.key()));
+                return loaded;
+            });
+
+            report("loadUsers", grouped);
+            report("per user ", perUser);
+            NavCommandLine::out().flush();
+        }
+    } catch (const NavDAOException &ex) {
+        NavCommandLine::err() << ex.what() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include "navlockstress.h"
+#include "navcommandline.h"
+#include "navigation.h"
+#include "navigationdao.h"
+#include "sessionwritequeue.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTextStream>
+#include <QVector>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+constexpr char kArguments[] = "<processes> <sessions> <database>";
+
+QString stressNick(int index)
+{
+    return QStringLiteral("stress_%1").arg(index);
+}
+
+struct ChildResult {
+    qint64 ok        = 0;
+    qint64 failed    = 0;
+    qint64 retries   = 0;
+    qint64 elapsedMs = 0;
+    bool   reported  = false;
+};
+
+ChildResult parseChildReport(const QByteArray &output)
+{
+    // Last line of the child's stdout: "<ok> <failed> <retries> <elapsedMs>".
+    ChildResult result;
+    const QList<QByteArray> lines = output.trimmed().split('\n');
+    const QList<QByteArray> fields = lines.last().simplified().split(' ');
+    if (fields.size() == 4) {
+        result.ok        = fields.at(0).toLongLong();
+        result.failed    = fields.at(1).toLongLong();
+        result.retries   = fields.at(2).toLongLong();
+        result.elapsedMs = fields.at(3).toLongLong();
+        result.reported  = true;
+    }
+    return result;
+}
+}
+
+int NavLockStress::run(const QStringList &arguments)
+{
+    if (arguments.size() != 5)
+        return NavCommandLine::usage(kFlag, kArguments);
+
+    bool countOk = false;
+    bool sessionsOk = false;
+    const int count    = arguments.at(2).toInt(&countOk);
+    const int sessions = arguments.at(3).toInt(&sessionsOk);
+    const QString &dbFilePath = arguments.at(4);
+    if (!countOk || !sessionsOk || count < 0 || sessions <= 0)
+        return NavCommandLine::usage(kFlag, kArguments);
+
+    if (arguments.at(1) == QLatin1String(kChildFlag))
+        return runChild(count, sessions, dbFilePath);
+    if (count == 0)
+        return NavCommandLine::usage(kFlag, kArguments);
+    return runParent(count, sessions, dbFilePath);
+}
+
+int NavLockStress::runParent(int processes, int sessions, const QString &dbFilePath)
+{
+    // Schema and users are set up once, so the children only append sessions.
+    try {
+        NavigationDAO dao(dbFilePath);
+        const QMap<QString, User> users = dao.loadUserRows();
+        for (int i = 0; i < processes; ++i) {
+            if (users.contains(stressNick(i)))
+                continue;
+            User user(stressNick(i), QStringLiteral("%1@stress.invalid").arg(stressNick(i)),
+                      QString(), QImage(), QDate(2000, 1, 1));
+            dao.saveUser(user);
+        }
+    } catch (const NavDAOException &ex) {
+        NavCommandLine::err() << ex.what() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+
+    NavCommandLine::out() << "stress: " << processes << " processes x " << sessions
+                          << " sessions on " << dbFilePath << '\n';
+    NavCommandLine::out().flush();
+
+    QElapsedTimer wall;
+    wall.start();
+
+    std::vector<std::unique_ptr<QProcess>> children;
+    for (int i = 0; i < processes; ++i) {
+        auto child = std::make_unique<QProcess>();
+        child->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        child->start(QCoreApplication::applicationFilePath(),
+                     {QString::fromLatin1(kChildFlag), QString::number(i), QString::number(sessions), dbFilePath});
+        children.push_back(std::move(child));
+    }
+
+    ChildResult total;
+    qint64 lost = 0;
+    for (int i = 0; i < processes; ++i) {
+        QProcess &child = *children.at(i);
+        child.waitForFinished(-1);
+
+        const ChildResult result = parseChildReport(child.readAllStandardOutput());
+        if (!result.reported) {
+            // A child that died counts all its sessions as failed.
+            ++lost;
+            total.failed += sessions;
+            NavCommandLine::out() << "  process " << i << ": no report (" << child.errorString() << ")\n";
+            continue;
+        }
+        NavCommandLine::out() << "  process " << i << ": " << result.ok << " ok, " << result.failed
+                              << " failed, " << result.retries << " retries, " << result.elapsedMs << " ms\n";
+        total.ok      += result.ok;
+        total.failed  += result.failed;
+        total.retries += result.retries;
+    }
+
+    const qint64 wallMs = qMax<qint64>(1, wall.elapsed());
+    NavCommandLine::out() << "total: " << total.ok << " ok, " << total.failed << " failed, "
+                          << total.retries << " retries, " << lost << " lost processes\n"
+                          << "throughput: " << QString::number(double(total.ok) * 1000.0 / double(wallMs), 'f', 1)
+                          << " sessions/s over " << wallMs << " ms\n";
+    NavCommandLine::out().flush();
+
+    return total.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int NavLockStress::runChild(int index, int sessions, const QString &dbFilePath)
+{
+    ChildResult result;
+    QElapsedTimer timer;
+    timer.start();
+
+    try {
+        // The app's own path: journal, then a write-behind batch on the
+        // database thread, with every child sharing the database and the
+        // journal directory.
+        Navigation::setDatabasePath(dbFilePath);
+        Navigation &navigation = Navigation::instance();
+        SessionWriteQueue queue(navigation, SessionWriteQueue::journalBaseFor(dbFilePath));
+        const QString nick = stressNick(index);
+        QString firstError;
+
+        for (int i = 0; i < sessions; ++i) {
+            SessionRecord session;
+            session.timestamp = QDateTime::currentDateTime().addMSecs(i);
+            session.hits = i % 7;
+            session.faults = i % 3;
+
+            QString errorMessage;
+            // Flushed one by one so every session is its own contended
+            // transaction; a failed one stays queued for the next flush.
+            if (!queue.enqueue(nick, session, errorMessage) || !queue.flush(errorMessage)) {
+                if (firstError.isEmpty())
+                    firstError = errorMessage;
+            }
+        }
+
+        QString errorMessage;
+        if (!queue.flush(errorMessage) && firstError.isEmpty())
+            firstError = errorMessage;
+        const qint64 stillPending = qint64(queue.pendingFor(nick).size());
+        result.failed = stillPending;
+        result.ok = sessions - stillPending;
+        result.retries = navigation.asyncDao()
+                             .run([](NavigationDAO &dao) { return qint64(dao.busyRetries()); })
+                             .result();
+
+        if (!firstError.isEmpty())
+            NavCommandLine::err() << "process " << index << ": " << firstError << '\n';
+    } catch (const NavDAOException &ex) {
+        NavCommandLine::err() << "process " << index << ": " << ex.what() << '\n';
+        result.failed = sessions - result.ok;
+    }
+    NavCommandLine::err().flush();
+
+    result.elapsedMs = timer.elapsed();
+    NavCommandLine::out() << result.ok << ' ' << result.failed << ' ' << result.retries << ' '
+                          << result.elapsedMs << '\n';
+    NavCommandLine::out().flush();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+#include "navoptionsbench.h"
+#include "navcommandline.h"
+#include "navoptionscodec.h"
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVariant>
+
+#include <cstdlib>
+
+namespace {
+constexpr char kArguments[] = "[attempts]";
+constexpr int kDefaultAttempts = 1000000;
+constexpr int kBatchSize = 10000;
+
+// Four answers of the length the bank uses, one of them correct. The same
+// seed gives both encodings the same data.
+QVector<Answer> makeOptions(QRandomGenerator &random, int attempt)
+{
+    QVector<Answer> answers;
+    const int correct = random.bounded(4);
+    for (int i = 0; i < 4; ++i) {
+        answers.push_back(Answer(QStringLiteral("Rumbo %1º, distancia %2 millas (opción %3 del intento %4)")
+                                     .arg(random.bounded(360))
+                                     .arg(random.bounded(1, 100))
+                                     .arg(i + 1)
+                                     .arg(attempt),
+                                 i == correct));
+    }
+    return answers;
+}
+
+struct Result {
+    qint64 bytes    = 0;
+    qint64 encodeMs = 0;
+    qint64 insertMs = 0;
+    qint64 loadMs   = 0;
+    qint64 decoded  = 0;
+};
+
+bool runEncoding(const QString &dbFilePath, bool cbor, int attempts, Result &result)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), dbFilePath);
+    db.setDatabaseName(dbFilePath);
+    if (!db.open()) {
+        NavCommandLine::err() << db.lastError().text() << '\n';
+        return false;
+    }
+
+    QSqlQuery q(db);
+    if (!q.exec(QStringLiteral("PRAGMA journal_mode = OFF;"))
+        || !q.exec(QStringLiteral("PRAGMA synchronous = OFF;"))
+        || !q.exec(QStringLiteral("CREATE TABLE bench(id INTEGER PRIMARY KEY, options BLOB);"))) {
+        NavCommandLine::err() << q.lastError().text() << '\n';
+        return false;
+    }
+
+    QRandomGenerator random(20240601);
+    QElapsedTimer timer;
+    db.transaction();
+    if (!q.prepare(QStringLiteral("INSERT INTO bench(options) VALUES(?);"))) {
+        NavCommandLine::err() << q.lastError().text() << '\n';
+        return false;
+    }
+    for (int first = 0; first < attempts; first += kBatchSize) {
+        const int last = qMin(first + kBatchSize, attempts);
+        QVector<QVector<Answer>> batch;
+        batch.reserve(last - first);
+        for (int i = first; i < last; ++i)
+            batch.push_back(makeOptions(random, i));
+
+        timer.start();
+        QVariantList encoded;
+        encoded.reserve(batch.size());
+        for (const QVector<Answer> &answers : batch) {
+            const QByteArray bytes = cbor ? NavOptionsCodec::encode(answers)
+                                          : NavOptionsCodec::encodeJson(answers);
+            result.bytes += bytes.size();
+            encoded << bytes;
+        }
+        result.encodeMs += timer.elapsed();
+
+        timer.start();
+        q.bindValue(0, encoded);
+        if (!q.execBatch()) {
+            NavCommandLine::err() << q.lastError().text() << '\n';
+            return false;
+        }
+        result.insertMs += timer.elapsed();
+    }
+    timer.start();
+    db.commit();
+    result.insertMs += timer.elapsed();
+
+    // What loadSessionAttempts does per row: fetch the column and decode it.
+    timer.start();
+    QSqlQuery load(db);
+    load.setForwardOnly(true);
+    if (!load.exec(QStringLiteral("SELECT options FROM bench ORDER BY id;"))) {
+        NavCommandLine::err() << load.lastError().text() << '\n';
+        return false;
+    }
+    while (load.next())
+        result.decoded += NavOptionsCodec::decode(load.value(0).toByteArray()).size();
+    result.loadMs = timer.elapsed();
+    return true;
+}
+
+void report(const char *name, const Result &r, int attempts)
+{
+    NavCommandLine::out() << "  " << name << ": " << r.bytes << " bytes ("
+                          << QString::number(double(r.bytes) / attempts, 'f', 1) << " per attempt), encode "
+                          << r.encodeMs << " ms, insert " << r.insertMs << " ms, load+decode "
+                          << r.loadMs << " ms, " << r.decoded << " options\n";
+}
+}
+
+int NavOptionsBench::run(const QStringList &arguments)
+{
+    if (arguments.size() > 3)
+        return NavCommandLine::usage(kFlag, kArguments);
+
+    int attempts = kDefaultAttempts;
+    if (arguments.size() == 3) {
+        bool ok = false;
+        attempts = arguments.at(2).toInt(&ok);
+        if (!ok || attempts <= 0)
+            return NavCommandLine::usage(kFlag, kArguments);
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        NavCommandLine::err() << dir.errorString() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+
+    NavCommandLine::out() << "options encoding: " << attempts << " attempts\n";
+    NavCommandLine::out().flush();
+
+    Result json, cbor;
+    const QString jsonPath = dir.filePath(QStringLiteral("json.sqlite"));
+    const QString cborPath = dir.filePath(QStringLiteral("cbor.sqlite"));
+    const bool ok = runEncoding(jsonPath, false, attempts, json)
+                    && runEncoding(cborPath, true, attempts, cbor);
+    QSqlDatabase::removeDatabase(jsonPath);
+    QSqlDatabase::removeDatabase(cborPath);
+    if (!ok) {
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+
+    report("json", json, attempts);
+    report("cbor", cbor, attempts);
+    NavCommandLine::out().flush();
+    return EXIT_SUCCESS;
+}
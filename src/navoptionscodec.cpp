@@ -0,0 +1,111 @@
+#include "navoptionscodec.h"
+
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+const char kSignature[] = "\xd9\xd9\xf7";
+
+QString readText(QCborStreamReader &reader)
+{
+    QString text;
+    auto chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        text += chunk.data;
+        chunk = reader.readString();
+    }
+    return text;
+}
+
+QVector<Answer> decodeCbor(const QByteArray &bytes)
+{
+    QVector<Answer> answers;
+    QCborStreamReader reader(bytes);
+    if (reader.isTag() && reader.toTag() == QCborTag(QCborKnownTags::Signature))
+        reader.next();
+    if (!reader.isArray() || !reader.enterContainer())
+        return answers;
+
+    while (reader.lastError() == QCborError::NoError && reader.hasNext()) {
+        if (!reader.isArray()) {
+            reader.next();
+            continue;
+        }
+        reader.enterContainer();
+        Answer answer;
+        if (reader.hasNext()) {
+            if (reader.isString())
+                answer.setText(readText(reader));
+            else
+                reader.next();
+        }
+        if (reader.hasNext()) {
+            if (reader.isBool())
+                answer.setValidity(reader.toBool());
+            reader.next();
+        }
+        while (reader.lastError() == QCborError::NoError && reader.hasNext())
+            reader.next();
+        reader.leaveContainer();
+        answers.push_back(answer);
+    }
+    return answers;
+}
+
+QVector<Answer> decodeJson(const QByteArray &bytes)
+{
+    QVector<Answer> answers;
+    const QJsonDocument doc = QJsonDocument::fromJson(bytes);
+    if (!doc.isArray())
+        return answers;
+    for (const QJsonValue &value : doc.array()) {
+        if (!value.isObject())
+            continue;
+        const QJsonObject object = value.toObject();
+        answers.push_back(Answer(object.value(QLatin1String("text")).toString(),
+                                 object.value(QLatin1String("correct")).toBool()));
+    }
+    return answers;
+}
+}
+
+QByteArray NavOptionsCodec::encode(const QVector<Answer> &answers)
+{
+    QByteArray bytes;
+    QCborStreamWriter writer(&bytes);
+    writer.append(QCborKnownTags::Signature);
+    writer.startArray(quint64(answers.size()));
+    for (const Answer &a : answers) {
+        writer.startArray(2);
+        writer.append(a.text());
+        writer.append(a.validity());
+        writer.endArray();
+    }
+    writer.endArray();
+    return bytes;
+}
+
+QByteArray NavOptionsCodec::encodeJson(const QVector<Answer> &answers)
+{
+    QJsonArray array;
+    for (const Answer &a : answers) {
+        array.append(QJsonObject{{QStringLiteral("text"), a.text()},
+                                 {QStringLiteral("correct"), a.validity()}});
+    }
+    return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+QVector<Answer> NavOptionsCodec::decode(const QByteArray &bytes)
+{
+    if (bytes.isEmpty())
+        return {};
+    return isCbor(bytes) ? decodeCbor(bytes) : decodeJson(bytes);
+}
+
+bool NavOptionsCodec::isCbor(const QByteArray &bytes)
+{
+    return bytes.startsWith(QByteArray::fromRawData(kSignature, 3));
+}
@@ -0,0 +1,138 @@
+#include "navquerystats.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+void dumpQueryStats()
+{
+    const QString target = qEnvironmentVariable("PER_QUERY_STATS").trimmed();
+    const QByteArray text = NavQueryStats::instance().report().toUtf8();
+
+    if (target == QLatin1String("1")) {
+        std::fputs(text.constData(), stderr);
+        return;
+    }
+
+    QFile file(target);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        file.write(text);
+    }
+}
+}
+
+NavQueryStats &NavQueryStats::instance()
+{
+    static NavQueryStats s_instance;
+    return s_instance;
+}
+
+void NavQueryStats::installFromEnvironment()
+{
+    bool ok = false;
+    const qint64 threshold = qEnvironmentVariable("PER_SLOW_QUERY_MS").toLongLong(&ok);
+    if (ok) {
+        instance().setSlowThresholdMs(threshold);
+    }
+
+    if (!qEnvironmentVariable("PER_QUERY_STATS").trimmed().isEmpty()) {
+        qAddPostRoutine(dumpQueryStats);
+    }
+}
+
+void NavQueryStats::record(const char *statement, const QSqlQuery &query, qint64 elapsedNs, qint64 rows)
+{
+    const QString key = QString::fromLatin1(statement);
+    {
+        QMutexLocker lock(&m_mutex);
+        Entry &e = m_entries[key];
+        if (e.statement.isEmpty())
+            e.statement = key;
+        ++e.calls;
+        e.rows    += quint64(std::max<qint64>(rows, 0));
+        e.totalNs += elapsedNs;
+        e.maxNs    = std::max(e.maxNs, elapsedNs);
+    }
+
+    const qint64 threshold = slowThresholdMs();
+    if (threshold >= 0 && elapsedNs >= threshold * 1000000) {
+        qWarning().noquote()
+            << QStringLiteral("slow query %1: %2 ms, %3 rows, %4 bound values: %5")
+                   .arg(key)
+                   .arg(double(elapsedNs) / 1e6, 0, 'f', 1)
+                   .arg(rows)
+                   .arg(query.boundValues().size())
+                   .arg(query.lastQuery().simplified());
+    }
+}
+
+QVector<NavQueryStats::Entry> NavQueryStats::snapshot() const
+{
+    QVector<Entry> entries;
+    {
+        QMutexLocker lock(&m_mutex);
+        entries.reserve(m_entries.size());
+        for (const Entry &e : m_entries)
+            entries.push_back(e);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.totalNs > b.totalNs;
+    });
+    return entries;
+}
+
+QString NavQueryStats::report() const
+{
+    QString text;
+    QTextStream out(&text);
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6\n")
+               .arg(QStringLiteral("statement"), -32)
+               .arg(QStringLiteral("calls"), 8)
+               .arg(QStringLiteral("total ms"), 10)
+               .arg(QStringLiteral("avg ms"), 8)
+               .arg(QStringLiteral("max ms"), 8)
+               .arg(QStringLiteral("rows"), 10);
+
+    for (const Entry &e : snapshot()) {
+        const double totalMs = double(e.totalNs) / 1e6;
+        out << QStringLiteral("%1 %2 %3 %4 %5 %6\n")
+                   .arg(e.statement, -32)
+                   .arg(e.calls, 8)
+                   .arg(totalMs, 10, 'f', 2)
+                   .arg(e.calls ? totalMs / double(e.calls) : 0.0, 8, 'f', 3)
+                   .arg(double(e.maxNs) / 1e6, 8, 'f', 2)
+                   .arg(e.rows, 10);
+    }
+    return text;
+}
+
+void NavQueryStats::reset()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+}
+
+NavQueryTimer::NavQueryTimer(const char *statement, const QSqlQuery &query)
+    : m_statement(statement)
+    , m_query(query)
+{
+    m_timer.start();
+}
+
+NavQueryTimer::~NavQueryTimer()
+{
+    qint64 rows = m_rows;
+    // Statements that were already finished no longer know what they changed.
+    if (rows == 0 && !m_query.isSelect()) {
+        rows = qMax<qint64>(0, m_query.numRowsAffected());
+    }
+    NavQueryStats::instance().record(m_statement, m_query, m_timer.nsecsElapsed(), rows);
+}
@@ -0,0 +1,244 @@
+#include "navrowdecoderbench.h"
+#include "navcommandline.h"
+#include "navrowdecoder.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVariant>
+
+#include <cstdlib>
+#include <initializer_list>
+#include <optional>
+
+namespace {
+constexpr char kArguments[] = "[rows]";
+constexpr int kDefaultRows = 100000;
+constexpr int kAnswers = 4;
+
+bool exec(QSqlQuery &q, const QString &sql)
+{
+    if (q.exec(sql))
+        return true;
+    NavCommandLine::err() << q.lastError().text() << '\n';
+    return false;
+}
+
+bool fill(QSqlDatabase &db, int rows)
+{
+    QSqlQuery q(db);
+    if (!exec(q, QStringLiteral("PRAGMA journal_mode = OFF;"))
+        || !exec(q, QStringLiteral("PRAGMA synchronous = OFF;"))
+        || !exec(q, QStringLiteral("CREATE TABLE session(userNickName TEXT, timeStamp TEXT, "
+                                   "timeStampMs INTEGER, hits INTEGER, faults INTEGER);"))
+        || !exec(q, QStringLiteral("CREATE TABLE problem(id INTEGER PRIMARY KEY, text TEXT, "
+                                   "answer1 TEXT, val1 INTEGER, answer2 TEXT, val2 INTEGER, "
+                                   "answer3 TEXT, val3 INTEGER, answer4 TEXT, val4 INTEGER);"))) {
+        return false;
+    }
+
+    QRandomGenerator random(20240601);
+    QVariantList nicks, stamps, stampsMs, hits, faults;
+    QVariantList texts;
+    QVariantList answers[kAnswers], valid[kAnswers];
+    const qint64 startMs = QDateTime(QDate(2024, 1, 1), QTime(9, 0)).toMSecsSinceEpoch();
+    for (int i = 0; i < rows; ++i) {
+        const qint64 ms = startMs + qint64(i) * 60000;
+        nicks << QStringLiteral("synth_%1").arg(i % 1000);
+        stamps << QDateTime::fromMSecsSinceEpoch(ms).toString(Qt::ISODateWithMs);
+        stampsMs << ms;
+        hits << random.bounded(11);
+        faults << random.bounded(6);
+
+        texts << QStringLiteral("Problema %1: calcula el rumbo y la distancia.").arg(i + 1);
+        const int correct = random.bounded(kAnswers);
+        for (int a = 0; a < kAnswers; ++a) {
+            answers[a] << QStringLiteral("Rumbo %1º, %2 millas").arg(random.bounded(360)).arg(random.bounded(1, 60));
+            valid[a] << (a == correct ? 1 : 0);
+        }
+    }
+
+    db.transaction();
+    QSqlQuery sessions(db);
+    sessions.prepare(QStringLiteral("INSERT INTO session VALUES(?,?,?,?,?);"));
+    sessions.addBindValue(nicks);
+    sessions.addBindValue(stamps);
+    sessions.addBindValue(stampsMs);
+    sessions.addBindValue(hits);
+    sessions.addBindValue(faults);
+    QSqlQuery problems(db);
+    problems.prepare(QStringLiteral("INSERT INTO problem(text, answer1, val1, answer2, val2, "
+                                    "answer3, val3, answer4, val4) VALUES(?,?,?,?,?,?,?,?,?);"));
+    problems.addBindValue(texts);
+    for (int a = 0; a < kAnswers; ++a) {
+        problems.addBindValue(answers[a]);
+        problems.addBindValue(valid[a]);
+    }
+    if (!sessions.execBatch() || !problems.execBatch()) {
+        NavCommandLine::err() << sessions.lastError().text() << problems.lastError().text() << '\n';
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+// Reads the columns of the current row; the sum it returns keeps the reads
+// from being optimised away.
+using RowReader = qint64 (*)(const QSqlQuery &, const NavRowDecoder *);
+
+// Runs sql and hands every row to readRow; returns the elapsed ms, or -1.
+qint64 scan(QSqlDatabase &db, const QString &sql, RowReader readRow,
+            std::initializer_list<const char *> columns, bool useDecoder, qint64 &checksum)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!exec(q, sql))
+        return -1;
+
+    std::optional<NavRowDecoder> decoder;
+    if (useDecoder)
+        decoder.emplace(q, columns);
+    while (q.next())
+        checksum += readRow(q, decoder ? &*decoder : nullptr);
+    return timer.elapsed();
+}
+
+enum SessionColumn { Nick, Stamp, StampMs, Hits, Faults };
+
+qint64 sessionByName(const QSqlQuery &q, const NavRowDecoder *)
+{
+    return q.value(QStringLiteral("userNickName")).toString().size()
+           + q.value(QStringLiteral("timeStamp")).toString().size()
+           + q.value(QStringLiteral("timeStampMs")).toLongLong() % 7
+           + q.value(QStringLiteral("hits")).toInt()
+           + q.value(QStringLiteral("faults")).toInt();
+}
+
+qint64 sessionByDecoder(const QSqlQuery &q, const NavRowDecoder *cols)
+{
+    return cols->value(q, Nick).toString().size()
+           + cols->value(q, Stamp).toString().size()
+           + cols->value(q, StampMs).toLongLong() % 7
+           + cols->value(q, Hits).toInt()
+           + cols->value(q, Faults).toInt();
+}
+
+qint64 sessionByIndex(const QSqlQuery &q, const NavRowDecoder *)
+{
+    return q.value(0).toString().size() + q.value(1).toString().size()
+           + q.value(2).toLongLong() % 7 + q.value(3).toInt() + q.value(4).toInt();
+}
+
+// What buildProblemFromQuery() did before NavRowDecoder: the column names
+// are formatted again on every row.
+qint64 problemByName(const QSqlQuery &q, const NavRowDecoder *)
+{
+    qint64 sum = q.value(QStringLiteral("text")).toString().size();
+    for (int a = 1; a <= kAnswers; ++a) {
+        sum += q.value(QStringLiteral("answer%1").arg(a)).toString().size();
+        sum += q.value(QStringLiteral("val%1").arg(a)).toInt();
+    }
+    return sum;
+}
+
+qint64 problemByDecoder(const QSqlQuery &q, const NavRowDecoder *cols)
+{
+    qint64 sum = cols->value(q, 0).toString().size();
+    for (int a = 0; a < kAnswers; ++a) {
+        sum += cols->value(q, 1 + 2 * a).toString().size();
+        sum += cols->value(q, 2 + 2 * a).toInt();
+    }
+    return sum;
+}
+
+qint64 problemByIndex(const QSqlQuery &q, const NavRowDecoder *)
+{
+    qint64 sum = q.value(0).toString().size();
+    for (int a = 0; a < kAnswers; ++a) {
+        sum += q.value(1 + 2 * a).toString().size();
+        sum += q.value(2 + 2 * a).toInt();
+    }
+    return sum;
+}
+
+bool runTable(QSqlDatabase &db, const char *name, const QString &sql,
+              std::initializer_list<const char *> columns,
+              RowReader byName, RowReader byDecoder, RowReader byIndex)
+{
+    // One untimed pass first, so every timed pass reads warm pages.
+    qint64 warm = 0, named = 0, decoded = 0, indexed = 0;
+    if (scan(db, sql, byIndex, columns, false, warm) < 0)
+        return false;
+
+    const qint64 nameMs    = scan(db, sql, byName, columns, false, named);
+    const qint64 decoderMs = scan(db, sql, byDecoder, columns, true, decoded);
+    const qint64 indexMs   = scan(db, sql, byIndex, columns, false, indexed);
+    if (nameMs < 0 || decoderMs < 0 || indexMs < 0)
+        return false;
+    if (named != decoded || decoded != indexed) {
+        NavCommandLine::err() << name << ": passes read different values\n";
+        return false;
+    }
+
+    NavCommandLine::out() << "  " << name << ": by name " << nameMs << " ms, NavRowDecoder " << decoderMs
+                          << " ms, by index " << indexMs << " ms\n";
+    return true;
+}
+}
+
+int NavRowDecoderBench::run(const QStringList &arguments)
+{
+    if (arguments.size() > 3)
+        return NavCommandLine::usage(kFlag, kArguments);
+
+    int rows = kDefaultRows;
+    if (arguments.size() == 3) {
+        bool ok = false;
+        rows = arguments.at(2).toInt(&ok);
+        if (!ok || rows <= 0)
+            return NavCommandLine::usage(kFlag, kArguments);
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        NavCommandLine::err() << dir.errorString() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+
+    NavCommandLine::out() << "row decoding: " << rows << " rows per table\n";
+    NavCommandLine::out().flush();
+
+    const QString dbFilePath = dir.filePath(QStringLiteral("decoder.sqlite"));
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), dbFilePath);
+        db.setDatabaseName(dbFilePath);
+        if (!db.open()) {
+            NavCommandLine::err() << db.lastError().text() << '\n';
+        } else {
+            ok = fill(db, rows)
+                 && runTable(db, "session",
+                             QStringLiteral("SELECT userNickName, timeStamp, timeStampMs, hits, faults FROM session;"),
+                             {"userNickName", "timeStamp", "timeStampMs", "hits", "faults"},
+                             sessionByName, sessionByDecoder, sessionByIndex)
+                 && runTable(db, "problem",
+                             QStringLiteral("SELECT text, answer1, val1, answer2, val2, answer3, val3, "
+                                            "answer4, val4 FROM problem;"),
+                             {"text", "answer1", "val1", "answer2", "val2", "answer3", "val3", "answer4", "val4"},
+                             problemByName, problemByDecoder, problemByIndex);
+        }
+    }
+    QSqlDatabase::removeDatabase(dbFilePath);
+
+    NavCommandLine::out().flush();
+    NavCommandLine::err().flush();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,342 @@
+#include "navsyntheticdataset.h"
+#include "navcommandline.h"
+#include "navconnectionmanager.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QUuid>
+#include <QVariant>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+// Users written per transaction: few enough commits to stay fast on a
+// durable connection, small enough to keep the journal modest.
+constexpr int kUsersPerTransaction = 100;
+
+QString synthNick(int index)
+{
+    return QStringLiteral("synth_%1").arg(index);
+}
+
+struct BankEntry {
+    qint64 id           = 0;
+    int    answers      = 0;
+    int    correctIndex = 0;
+};
+
+QVector<Problem> makeProblems(QRandomGenerator &random, int first, int count)
+{
+    QVector<Problem> problems;
+    problems.reserve(count);
+    for (int i = first; i < first + count; ++i) {
+        const int correct = random.bounded(4);
+        QVector<Answer> answers;
+        for (int a = 0; a < 4; ++a) {
+            answers.push_back(Answer(QStringLiteral("Rumbo %1º, %2 millas")
+                                         .arg(random.bounded(360))
+                                         .arg(random.bounded(1, 60)),
+                                     a == correct));
+        }
+        problems.push_back(Problem(
+            QStringLiteral("Problema sintético %1: calcula el rumbo y la distancia entre "
+                           "la posición de salida y el punto de llegada indicado en la carta.")
+                .arg(i + 1),
+            answers));
+    }
+    return problems;
+}
+
+// Day offset before end, weekdays three times as likely as weekends.
+int sessionDay(QRandomGenerator &random, const QDate &endDate, int firstDay)
+{
+    for (;;) {
+        const int day = random.bounded(firstDay + 1);
+        const int weekday = endDate.addDays(-day).dayOfWeek();
+        if (weekday <= 5 || random.bounded(3) == 0)
+            return day;
+    }
+}
+
+// Milliseconds into the day: mostly morning classes or evening study.
+int sessionTimeOfDay(QRandomGenerator &random)
+{
+    const int roll = random.bounded(10);
+    int hour;
+    if (roll < 6)
+        hour = 16 + random.bounded(6);
+    else if (roll < 9)
+        hour = 9 + random.bounded(5);
+    else
+        hour = random.bounded(24);
+    return ((hour * 60 + random.bounded(60)) * 60 + random.bounded(60)) * 1000 + random.bounded(1000);
+}
+
+// A version-4 UUID drawn from random rather than QUuid::createUuid(), so
+// the seed decides the attempt ids as well.
+QString attemptId(QRandomGenerator &random)
+{
+    const quint64 high = random.generate64();
+    const quint64 low  = random.generate64();
+    const QUuid id(quint32(high >> 32), quint16(high >> 16), quint16((high & 0x0fff) | 0x4000),
+                   uchar(((low >> 56) & 0x3f) | 0x80), uchar(low >> 48), uchar(low >> 40), uchar(low >> 32),
+                   uchar(low >> 24), uchar(low >> 16), uchar(low >> 8), uchar(low));
+    return id.toString(QUuid::WithoutBraces);
+}
+
+quint32 parseCount(const QCommandLineParser &parser, const QString &name, quint32 fallback, bool &ok)
+{
+    if (!parser.isSet(name))
+        return fallback;
+    bool valid = false;
+    const uint value = parser.value(name).toUInt(&valid);
+    if (!valid)
+        ok = false;
+    return valid ? value : fallback;
+}
+}
+
+NavSyntheticDataset::Stats NavSyntheticDataset::generate(NavigationDAO &dao, const Options &options,
+                                                         const NavigationDAO::ProgressCallback &progress,
+                                                         const NavigationDAO::ProgressCallback &importProgress)
+{
+    Stats stats;
+    QElapsedTimer timer;
+    timer.start();
+    QRandomGenerator random(options.seed);
+
+    // Problems are added to the bank; the ones already there keep their ids.
+    QVector<Problem> bank = dao.loadProblems();
+    if (options.problems > 0) {
+        QVector<Problem> all = bank;
+        all += makeProblems(random, int(bank.size()), options.problems);
+        QElapsedTimer importTimer;
+        importTimer.start();
+        dao.replaceAllProblems(all, importProgress);
+        stats.importMs = importTimer.elapsed();
+        bank = dao.loadProblems();
+        stats.problems = options.problems;
+    }
+
+    QVector<BankEntry> entries;
+    for (const Problem &p : bank) {
+        const QVector<Answer> &answers = p.answers();
+        if (answers.isEmpty())
+            continue;
+        BankEntry entry;
+        entry.id = p.id();
+        entry.answers = int(answers.size());
+        for (int i = 0; i < answers.size(); ++i) {
+            if (answers.at(i).validity()) {
+                entry.correctIndex = i;
+                break;
+            }
+        }
+        entries.push_back(entry);
+    }
+
+    const QMap<QString, User> existing = dao.loadUserRows();
+    int nextUser = 0;
+    while (existing.contains(synthNick(nextUser)))
+        ++nextUser;
+
+    // The same row storeAttempts() writes for an attempt on an unchanged
+    // bank problem.
+    QSqlDatabase db = NavConnectionManager::connection(dao.databasePath());
+    QSqlQuery history(db);
+    if (!history.prepare(QStringLiteral(
+            "INSERT INTO question_history(userNickName, sessionTimestamp, attemptTimestamp, problemId, "
+            "wasCorrect, selectedIndex, correctIndex, sessionTimestampMs, attemptTimestampMs, attemptId) "
+            "VALUES(?,?,?,?,?,?,?,?,?,?);"))) {
+        throw NavDAOException(QStringLiteral("NavSyntheticDataset: %1").arg(history.lastError().text()));
+    }
+
+    const QDate endDate = options.end.date();
+    const qint64 endMs = options.end.toMSecsSinceEpoch();
+    const int days = qMax(1, options.days);
+    if (progress)
+        progress(0, options.users);
+
+    for (int first = 0; first < options.users; first += kUsersPerTransaction) {
+        const int last = qMin(first + kUsersPerTransaction, options.users);
+        qint64 sessions = 0;
+        qint64 attemptRows = 0;
+        const QRandomGenerator batchStart = random;
+        dao.writeTransaction("NavSyntheticDataset.generate", [&] {
+            // A busy retry runs the body again: it restarts from the same
+            // generator state, so the seed still decides the data, and the
+            // counts are redone.
+            random = batchStart;
+            sessions = 0;
+            attemptRows = 0;
+            for (int u = first; u < last; ++u) {
+                const QString nick = synthNick(nextUser + u);
+                User user(nick, QStringLiteral("%1@synthetic.invalid").arg(nick), QStringLiteral("synthetic"),
+                          QImage(), QDate(1990 + random.bounded(15), 1 + random.bounded(12), 1 + random.bounded(28)));
+                dao.saveUser(user);
+
+                // Some users started a while ago, others only recently.
+                const int firstDay = random.bounded(days / 4, days);
+                const int skillPercent = 40 + random.bounded(51);
+
+                QVector<qint64> starts;
+                starts.reserve(options.sessionsPerUser);
+                for (int s = 0; s < options.sessionsPerUser; ++s) {
+                    const QDate day = endDate.addDays(-sessionDay(random, endDate, firstDay));
+                    const qint64 ms = day.startOfDay().toMSecsSinceEpoch() + sessionTimeOfDay(random);
+                    starts.push_back(qMin(ms, endMs));
+                }
+                std::sort(starts.begin(), starts.end());
+                for (int s = 1; s < starts.size(); ++s) {
+                    // (user, session time) identifies a session.
+                    if (starts.at(s) <= starts.at(s - 1))
+                        starts[s] = starts.at(s - 1) + 1;
+                }
+
+                for (const qint64 startMs : std::as_const(starts)) {
+                    const QDateTime start = QDateTime::fromMSecsSinceEpoch(startMs);
+                    const QString sessionText = start.toString(Qt::ISODateWithMs);
+                    int hits = 0;
+                    int faults = 0;
+                    qint64 attemptMs = startMs;
+
+                    const int attempts = entries.isEmpty() ? 0 : options.attemptsPerSession;
+                    for (int a = 0; a < attempts; ++a) {
+                        const BankEntry &entry = entries.at(random.bounded(int(entries.size())));
+                        const bool correct = random.bounded(100) < skillPercent || entry.answers == 1;
+                        int selected = entry.correctIndex;
+                        if (!correct) {
+                            selected = (entry.correctIndex + 1 + random.bounded(entry.answers - 1)) % entry.answers;
+                        }
+                        if (correct)
+                            ++hits;
+                        else
+                            ++faults;
+                        attemptMs += 15000 + random.bounded(105000);
+
+                        history.bindValue(0, nick);
+                        history.bindValue(1, sessionText);
+                        history.bindValue(2, QDateTime::fromMSecsSinceEpoch(attemptMs).toString(Qt::ISODateWithMs));
+                        history.bindValue(3, entry.id);
+                        history.bindValue(4, correct ? 1 : 0);
+                        history.bindValue(5, selected);
+                        history.bindValue(6, entry.correctIndex);
+                        history.bindValue(7, startMs);
+                        history.bindValue(8, attemptMs);
+                        history.bindValue(9, attemptId(random));
+                        if (!history.exec()) {
+                            throw NavDAOException(QStringLiteral("NavSyntheticDataset: %1")
+                                                      .arg(history.lastError().text()));
+                        }
+                    }
+                    if (attempts == 0) {
+                        hits = random.bounded(11);
+                        faults = random.bounded(6);
+                    }
+
+                    dao.addSession(nick, Session(start, hits, faults));
+                    attemptRows += attempts;
+                }
+                sessions += starts.size();
+            }
+        });
+        stats.users    += last - first;
+        stats.sessions += sessions;
+        stats.attempts += attemptRows;
+        if (progress)
+            progress(last, options.users);
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    return stats;
+}
+
+int NavSyntheticDataset::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.addPositionalArgument(QStringLiteral("database"),
+                                 QStringLiteral("Database file, or :memory:"));
+    parser.addOptions({
+        {QString::fromLatin1(kFlag).mid(2), QStringLiteral("Generate a synthetic dataset.")},
+        {QStringLiteral("users"), QStringLiteral("Users to add."), QStringLiteral("n")},
+        {QStringLiteral("sessions"), QStringLiteral("Sessions per user."), QStringLiteral("n")},
+        {QStringLiteral("attempts"), QStringLiteral("Attempts per session."), QStringLiteral("n")},
+        {QStringLiteral("problems"), QStringLiteral("Problems to add to the bank."), QStringLiteral("n")},
+        {QStringLiteral("days"), QStringLiteral("Days the sessions are spread over."), QStringLiteral("n")},
+        {QStringLiteral("seed"), QStringLiteral("Random seed."), QStringLiteral("n")},
+        {QStringLiteral("bench-load"), QStringLiteral("Time the start-up load afterwards.")},
+    });
+
+    Options options;
+    bool ok = parser.parse(arguments) && parser.positionalArguments().size() == 1;
+    options.users              = int(parseCount(parser, QStringLiteral("users"), options.users, ok));
+    options.sessionsPerUser    = int(parseCount(parser, QStringLiteral("sessions"), options.sessionsPerUser, ok));
+    options.attemptsPerSession = int(parseCount(parser, QStringLiteral("attempts"), options.attemptsPerSession, ok));
+    options.problems           = int(parseCount(parser, QStringLiteral("problems"), options.problems, ok));
+    options.days               = int(parseCount(parser, QStringLiteral("days"), options.days, ok));
+    options.seed               = parseCount(parser, QStringLiteral("seed"), options.seed, ok);
+    if (!ok) {
+        if (!parser.errorText().isEmpty())
+            NavCommandLine::err() << parser.errorText() << '\n';
+        return NavCommandLine::usage(kFlag, "<database|:memory:> [--users N] [--sessions N] [--attempts N]"
+                                            " [--problems N] [--days N] [--seed N] [--bench-load]");
+    }
+    const QString dbFilePath = parser.positionalArguments().constFirst();
+
+    try {
+        NavigationDAO dao(dbFilePath);
+        NavCommandLine::out() << "generate: " << options.users << " users x " << options.sessionsPerUser
+                              << " sessions x " << options.attemptsPerSession << " attempts, "
+                              << options.problems << " problems into " << dbFilePath << '\n';
+        NavCommandLine::out().flush();
+
+        const Stats stats = generate(
+            dao, options,
+            [](qsizetype done, qsizetype total) {
+                NavCommandLine::out() << "\r  " << done << '/' << total << " users";
+                NavCommandLine::out().flush();
+            },
+            [](qsizetype done, qsizetype total) {
+                NavCommandLine::out() << "\r  " << done << '/' << total << " problems imported";
+                NavCommandLine::out().flush();
+            });
+        NavCommandLine::out() << "\n  " << stats.users << " users, " << stats.sessions << " sessions, "
+                              << stats.attempts << " attempts, " << stats.problems << " problems in "
+                              << stats.elapsedMs << " ms\n";
+        if (stats.problems > 0) {
+            const double rate = stats.importMs > 0 ? stats.problems * 1000.0 / stats.importMs : 0.0;
+            NavCommandLine::out() << "  import: " << stats.problems << " problems in " << stats.importMs << " ms ("
+                                  << QString::number(rate, 'f', 0) << " problems/s)\n";
+        }
+        NavCommandLine::out().flush();
+
+        if (parser.isSet(QStringLiteral("bench-load"))) {
+            // A fresh DAO, as Navigation builds one at start-up.
+            NavigationDAO reader(dbFilePath);
+            QElapsedTimer timer;
+            timer.start();
+            qint64 watermark = 0;
+            const QMap<QString, User> users = reader.loadUsers(&watermark);
+            const qint64 usersMs = timer.restart();
+            const QVector<Problem> problems = reader.loadProblems();
+            const qint64 problemsMs = timer.elapsed();
+
+            qint64 sessions = 0;
+            for (const User &user : users)
+                sessions += user.sessions().size();
+            NavCommandLine::out() << "load: " << users.size() << " users with " << sessions << " sessions in "
+                                  << usersMs << " ms, " << problems.size() << " problems in " << problemsMs << " ms\n";
+            NavCommandLine::out().flush();
+        }
+    } catch (const NavDAOException &ex) {
+        NavCommandLine::err() << ex.what() << '\n';
+        NavCommandLine::err().flush();
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
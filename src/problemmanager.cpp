@@ -1,120 +1,95 @@
 #include "problemmanager.h"
+#include "navconnectionmanager.h"
+#include "navquerystats.h"
 
 #include <QRandomGenerator>
+#include <exception>
 #include <utility>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QDir>
-#include <QCoreApplication>
-#include <QFileInfo>
 
-ProblemManager::ProblemManager(Navigation &navigation, QObject *parent)
-    : QObject(parent), navigation_(navigation) {}
+namespace {
+// One ordered join: each problem row is followed by its answers, so entries
+// are built as the rows stream in. Problems without answers are skipped.
+// Runs on whichever thread calls it, on that thread's connection.
+QVector<ProblemEntry> readProblems(const QString &databasePath, const QString &defaultCategory) {
+    QVector<ProblemEntry> problems;
+    const QSqlDatabase db = NavConnectionManager::connection(databasePath);
+    if (!db.isOpen()) {
+        return problems;
+    }
 
-bool ProblemManager::load() {
-    problems_.clear();
-
-    // Try to load from DB directly to handle "true"/"false" strings correctly
-    QString dbPath;
-    QDir appDir(QCoreApplication::applicationDirPath());
-    
-    QStringList probes{
-        QStringLiteral("navdb.sqlite"),
-        QStringLiteral("../navdb.sqlite"),
-        QStringLiteral("../../navdb.sqlite"),
-        QStringLiteral("../../../navdb.sqlite")
-    };
-    
-    for (const auto &probe : probes) {
-        const QString candidate = appDir.absoluteFilePath(probe);
-        if (QFileInfo::exists(candidate)) {
-            dbPath = candidate;
-            break;
-        }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    NavQueryTimer timer("ProblemManager.load", query);
+    if (!query.exec(QStringLiteral("SELECT p.id, p.text, a.text, a.validity "
+                                   "FROM problem p "
+                                   "LEFT JOIN problem_answer a ON a.problemId = p.id "
+                                   "ORDER BY p.id, a.ordinal"))) {
+        return problems;
     }
-    
-    if (dbPath.isEmpty()) {
-        QDir walker(appDir);
-        for (int depth = 0; depth < 5 && walker.cdUp(); ++depth) {
-            // If we find the project folder "IHM_PER_QT", use the DB inside it
-            if (walker.exists(QStringLiteral("IHM_PER_QT"))) {
-                dbPath = walker.absoluteFilePath(QStringLiteral("IHM_PER_QT/navdb.sqlite"));
-                break;
-            }
 
-            QStringList candidates = {
-                QStringLiteral("navdb.sqlite"),
-                QStringLiteral("IHM_PER_QT/navdb.sqlite")
-            };
-            for (const auto &fname : candidates) {
-                const QString candidate = walker.absoluteFilePath(fname);
-                if (QFileInfo::exists(candidate)) {
-                    dbPath = candidate;
-                    break;
-                }
-            }
-            if (!dbPath.isEmpty()) break;
+    ProblemEntry entry;
+    const auto finishEntry = [&]() {
+        if (!entry.answers.isEmpty()) {
+            problems.push_back(std::move(entry));
         }
-    }
+        entry = ProblemEntry();
+    };
 
-    if (!dbPath.isEmpty()) {
-        {
-            const QString connectionName = QStringLiteral("ProblemManagerConnection");
-            QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
-            db.setDatabaseName(dbPath);
-            if (db.open()) {
-                QSqlQuery query(db);
-                if (query.exec(QStringLiteral("SELECT text, answer1, val1, answer2, val2, answer3, val3, answer4, val4 FROM problem"))) {
-                    int nextId = 1;
-                    const QString defaultCategory = tr("Banco navdb");
-                    
-                    while (query.next()) {
-                        ProblemEntry entry;
-                        entry.id = nextId++;
-                        entry.category = defaultCategory;
-                        entry.text = query.value(0).toString();
-                        
-                        for (int i = 1; i <= 7; i += 2) {
-                            QString ansText = query.value(i).toString();
-                            QString valText = query.value(i+1).toString();
-                            
-                            if (!ansText.isEmpty()) {
-                                AnswerOption option;
-                                option.text = ansText;
-                                // Handle "true"/"false" strings and integers
-                                const QString v = valText.trimmed();
-                                if (v.compare(QStringLiteral("true"), Qt::CaseInsensitive) == 0) {
-                                    option.valid = true;
-                                } else if (v.compare(QStringLiteral("false"), Qt::CaseInsensitive) == 0) {
-                                    option.valid = false;
-                                } else {
-                                    bool ok;
-                                    const int intVal = v.toInt(&ok);
-                                    if (ok) {
-                                        option.valid = (intVal != 0);
-                                    } else {
-                                        option.valid = false;
-                                    }
-                                }
-                                entry.answers.push_back(option);
-                            }
-                        }
-                        
-                        if (!entry.answers.isEmpty()) {
-                            problems_.push_back(std::move(entry));
-                        }
-                    }
-                }
-                db.close();
+    while (query.next()) {
+        timer.addRow();
+        const int id = query.value(0).toInt();
+        if (id != entry.id) {
+            if (entry.id != -1) {
+                finishEntry();
             }
+            entry.id = id;
+            entry.category = defaultCategory;
+            entry.text = query.value(1).toString();
         }
-        QSqlDatabase::removeDatabase(QStringLiteral("ProblemManagerConnection"));
+
+        if (!query.value(2).isNull()) {
+            AnswerOption option;
+            option.text = query.value(2).toString();
+            option.valid = query.value(3).toInt() != 0;
+            entry.answers.push_back(std::move(option));
+        }
+    }
+    if (entry.id != -1) {
+        finishEntry();
+    }
+    return problems;
+}
+} // namespace
+
+ProblemManager::ProblemManager(Navigation &navigation, QObject *parent)
+    : QObject(parent), navigation_(navigation) {}
+
+bool ProblemManager::load() {
+    adoptProblems(readProblems(navigation_.dao().databasePath(), tr("Banco navdb")));
+    return true;
+}
+
+QFuture<void> ProblemManager::loadAsync() {
+    return navigation_.asyncDao()
+        .run([category = tr("Banco navdb")](NavigationDAO &dao) {
+            return readProblems(dao.databasePath(), category);
+        })
+        .then(this, [this](QVector<ProblemEntry> problems) { adoptProblems(std::move(problems)); });
+}
+
+void ProblemManager::adoptProblems(QVector<ProblemEntry> problems) {
+    problems_ = std::move(problems);
+    indexById_.clear();
+    for (int i = 0; i < problems_.size(); ++i) {
+        indexById_.insert(problems_.at(i).id, i);
     }
 
     if (!problems_.isEmpty()) {
         emit problemsChanged();
-        return true;
+        return;
     }
 
     // Fallback to Navigation if DB load failed
@@ -123,12 +98,11 @@ bool ProblemManager::load() {
     const auto &navProblems = navigation_.problems();
     problems_.reserve(navProblems.size());
 
-    int nextId = 1;
     const QString defaultCategory = tr("Banco navdb");
 
     for (const auto &navProblem : navProblems) {
         ProblemEntry entry;
-        entry.id = nextId++;
+        entry.id = int(navProblem.id());
         entry.category = defaultCategory;
         entry.text = navProblem.text();
 
@@ -142,12 +116,12 @@ bool ProblemManager::load() {
         }
 
         if (!entry.answers.isEmpty()) {
+            indexById_.insert(entry.id, int(problems_.size()));
             problems_.push_back(std::move(entry));
         }
     }
 
     emit problemsChanged();
-    return true;
 }
 
 QVector<ProblemEntry> ProblemManager::problems() const {
@@ -155,12 +129,34 @@ QVector<ProblemEntry> ProblemManager::problems() const {
 }
 
 std::optional<ProblemEntry> ProblemManager::findById(int id) const {
-    for (const auto &problem : problems_) {
-        if (problem.id == id) {
-            return problem;
+    const auto it = indexById_.constFind(id);
+    if (it == indexById_.constEnd()) {
+        return std::nullopt;
+    }
+    return problems_.at(it.value());
+}
+
+QVector<int> ProblemManager::search(const QString &query, int limit) const {
+    QVector<int> ids;
+    if (problems_.isEmpty()) {
+        return ids;
+    }
+
+    QVector<qint64> found;
+    try {
+        found = navigation_.dao().searchProblems(query, limit);
+    } catch (const std::exception &) {
+        return ids;
+    }
+
+    // Problems skipped by load() are not offered.
+    ids.reserve(found.size());
+    for (const qint64 id : found) {
+        if (indexById_.contains(int(id))) {
+            ids.push_back(int(id));
         }
     }
-    return std::nullopt;
+    return ids;
 }
 
 std::optional<ProblemEntry> ProblemManager::randomProblem() const {
@@ -98,7 +98,7 @@ void ProfileDialog::setupUi() {
     avatarPreview_ = new QLabel();
     avatarPreview_->setFixedSize(96, 96);
     avatarPreview_->setStyleSheet(QStringLiteral("border: 1px solid #9cc6eb; border-radius: 6px;"));
-    const QString avatarPath = manager_.resolvedAvatarPath(user_.avatarPath);
+    const QString avatarPath = manager_.avatarThumbnailPath(user_.avatarPath, 96);
     avatarPreview_->setPixmap(QPixmap(avatarPath).scaled(96, 96, Qt::KeepAspectRatio, Qt::SmoothTransformation));
 
     auto *avatarButton = new QPushButton(tr("Cambiar avatar"));
@@ -212,7 +212,7 @@ void ProfileDialog::setupReadOnlyUi() {
     avatarPreview_ = new QLabel();
     avatarPreview_->setFixedSize(96, 96);
     avatarPreview_->setStyleSheet(QStringLiteral("border: 1px solid #9cc6eb; border-radius: 6px;"));
-    const QString avatarPath = manager_.resolvedAvatarPath(user_.avatarPath);
+    const QString avatarPath = manager_.avatarThumbnailPath(user_.avatarPath, 96);
     avatarPreview_->setPixmap(QPixmap(avatarPath).scaled(96, 96, Qt::KeepAspectRatio, Qt::SmoothTransformation));
     avatarPreview_->setAlignment(Qt::AlignCenter);
 
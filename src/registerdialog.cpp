@@ -69,14 +69,19 @@ void RegisterDialog::registerUser() {
     const auto password = passwordEdit_->text();
     const auto birthdate = birthdateEdit_->date();
 
-    if (!userManager_.registerUser(nickname, email, password, birthdate, avatarPath_, error)) {
-        feedbackLabel_->setText(error);
-        feedbackLabel_->setVisible(true);
-        return;
-    }
-
-    createdUser_ = userManager_.getUser(nickname);
-    accept();
+    registerButton_->setEnabled(false);
+    userManager_.registerUserAsync(nickname, email, password, birthdate, avatarPath_, this)
+        .then(this, [this, nickname](const QString &error) {
+            if (!error.isEmpty()) {
+                feedbackLabel_->setText(error);
+                feedbackLabel_->setVisible(true);
+                registerButton_->setEnabled(true);
+                return;
+            }
+
+            createdUser_ = userManager_.getUser(nickname);
+            accept();
+        });
 }
 
 void RegisterDialog::setupUi() {
@@ -9,11 +9,16 @@
 #include <QHeaderView>
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QPushButton>
 #include <QTableWidget>
 #include <QVBoxLayout>
 
-ResultsDialog::ResultsDialog(const QVector<SessionRecord> &sessions, QWidget *parent)
-    : QDialog(parent), sessions_(sessions) {
+namespace {
+constexpr int kSessionPageSize = 25;
+}
+
+ResultsDialog::ResultsDialog(const UserManager &userManager, const QString &nickname, QWidget *parent)
+    : QDialog(parent), userManager_(userManager), nickname_(nickname) {
     setWindowTitle(tr("Resultados de sesiones"));
     setModal(true);
     setupUi();
@@ -24,6 +29,17 @@ void ResultsDialog::updateFilter() {
     populateTable();
 }
 
+void ResultsDialog::loadMore() {
+    const int firstIndex = sessions_.size();
+    QString errorMessage;
+    if (!userManager_.fetchSessions(cursor_, kSessionPageSize, sessions_, errorMessage)) {
+        summaryLabel_->setText(errorMessage);
+    }
+    attemptsLoaded_.resize(sessions_.size());
+    appendRows(firstIndex);
+    loadMoreButton_->setEnabled(!cursor_.atEnd);
+}
+
 void ResultsDialog::setupUi() {
     auto *layout = new QVBoxLayout(this);
 
@@ -62,29 +78,42 @@ void ResultsDialog::setupUi() {
     attemptsTable_->setAlternatingRowColors(true);
     layout->addWidget(attemptsTable_);
 
+    auto *footerLayout = new QHBoxLayout();
+    loadMoreButton_ = new QPushButton(tr("Cargar más"));
+    footerLayout->addWidget(loadMoreButton_);
     summaryLabel_ = new QLabel();
     summaryLabel_->setAlignment(Qt::AlignRight);
-    layout->addWidget(summaryLabel_);
+    footerLayout->addWidget(summaryLabel_, 1);
+    layout->addLayout(footerLayout);
 
     connect(fromDateEdit_, &QDateEdit::dateChanged, this, [this](const QDate &) { populateTable(); });
+    connect(loadMoreButton_, &QPushButton::clicked, this, &ResultsDialog::loadMore);
     connect(table_, &QTableWidget::currentCellChanged, this, [this](int currentRow, int, int, int) {
         updateAttemptDetails(currentRow);
     });
 }
 
 void ResultsDialog::populateTable() {
-    const QDate fromDate = fromDateEdit_->date();
-
+    // Sessions are pulled a page at a time, newest first, from the selected date on.
+    cursor_ = userManager_.openSessionCursor(nickname_, fromDateEdit_->date().startOfDay());
+    sessions_.clear();
+    attemptsLoaded_.clear();
     visibleSessionIndexes_.clear();
     table_->setRowCount(0);
-    int totalHits = 0;
-    int totalFaults = 0;
 
-    for (int index = 0; index < sessions_.size(); ++index) {
+    loadMore();
+    updateSummary();
+
+    if (!visibleSessionIndexes_.isEmpty()) {
+        table_->setCurrentCell(0, 0);
+    } else {
+        updateAttemptDetails(-1);
+    }
+}
+
+void ResultsDialog::appendRows(int firstIndex) {
+    for (int index = firstIndex; index < sessions_.size(); ++index) {
         const auto &session = sessions_.at(index);
-        if (session.timestamp.date() < fromDate) {
-            continue;
-        }
         const int row = table_->rowCount();
         table_->insertRow(row);
         visibleSessionIndexes_.push_back(index);
@@ -92,20 +121,21 @@ void ResultsDialog::populateTable() {
         table_->setItem(row, 0, new QTableWidgetItem(session.timestamp.toString("dd/MM/yyyy hh:mm")));
         table_->setItem(row, 1, new QTableWidgetItem(QString::number(session.hits)));
         table_->setItem(row, 2, new QTableWidgetItem(QString::number(session.faults)));
+    }
+}
 
-        totalHits += session.hits;
-        totalFaults += session.faults;
+void ResultsDialog::updateSummary() {
+    // Totals cover the whole range, not only the pages loaded so far.
+    QString errorMessage;
+    const auto totals = userManager_.sessionTotals(cursor_, errorMessage);
+    if (!totals) {
+        summaryLabel_->setText(errorMessage);
+        return;
     }
 
     summaryLabel_->setText(tr("Total aciertos: %1 | Total fallos: %2")
-                               .arg(totalHits)
-                               .arg(totalFaults));
-
-    if (!visibleSessionIndexes_.isEmpty()) {
-        table_->setCurrentCell(0, 0);
-    } else {
-        updateAttemptDetails(-1);
-    }
+                               .arg(totals->hits)
+                               .arg(totals->faults));
 }
 
 void ResultsDialog::updateAttemptDetails(int visibleRow) {
@@ -125,7 +155,17 @@ void ResultsDialog::updateAttemptDetails(int visibleRow) {
         return;
     }
 
-    const auto &session = sessions_.at(visibleSessionIndexes_.at(visibleRow));
+    const int index = visibleSessionIndexes_.at(visibleRow);
+    if (!attemptsLoaded_.at(index)) {
+        QString errorMessage;
+        if (userManager_.sessionAttempts(nickname_, sessions_.at(index).timestamp, sessions_[index].attempts, errorMessage)) {
+            attemptsLoaded_[index] = true;
+        } else {
+            summaryLabel_->setText(errorMessage);
+        }
+    }
+
+    const auto &session = sessions_.at(index);
     attemptsHeaderLabel_->setText(tr("Intentos de la sesión • %1")
                                       .arg(session.timestamp.toString("dd/MM/yyyy hh:mm")));
 
@@ -0,0 +1,490 @@
+#include "sessionwritequeue.h"
+#include "navconnectionmanager.h"
+#include "navquerystats.h"
+#include "usermanager.h"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+#include <QUuid>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+// Sessions enqueued within this window share one transaction.
+constexpr int kFlushDelayMs = 200;
+// A session with stored attempts but no row after this long is not coming.
+constexpr int kAbandonedSessionSecs = 24 * 60 * 60;
+
+QJsonValue millisOrNull(const QDateTime &timestamp) {
+	return timestamp.isValid() ? QJsonValue(timestamp.toMSecsSinceEpoch()) : QJsonValue();
+}
+
+// QFile::flush() only reaches the OS; a session reported as saved must
+// survive a power cut as well.
+bool syncToDisk(QFile &file) {
+	if (!file.flush()) {
+		return false;
+	}
+#ifdef Q_OS_WIN
+	return _commit(file.handle()) == 0;
+#else
+	return ::fsync(file.handle()) == 0;
+#endif
+}
+
+// Id for an attempt journaled before attempts had ids. It is derived from
+// what identifies the attempt, so replaying the same entry after another
+// crash gives the same id and storeAttempts() skips it. The row key cannot
+// do that any more: by-reference rows have a NULL question.
+QString legacyAttemptId(const QString &nickname, const QDateTime &sessionTimestamp, const QuestionAttempt &attempt) {
+	static const QUuid kNamespace(QStringLiteral("5b8f2c1e-7d4a-4f0b-9c3e-2a6d1e8f4b70"));
+	const QString name = QStringLiteral("%1\n%2\n%3\n%4\n%5")
+							 .arg(nickname)
+							 .arg(sessionTimestamp.toMSecsSinceEpoch())
+							 .arg(attempt.timestamp.isValid() ? attempt.timestamp.toMSecsSinceEpoch() : -1)
+							 .arg(attempt.problemId)
+							 .arg(attempt.question);
+	return QUuid::createUuidV5(kNamespace, name).toString(QUuid::WithoutBraces);
+}
+
+QString journalFile(const QString &base, const QString &owner) {
+	return QStringLiteral("%1.%2.journal").arg(base, owner);
+}
+
+QString lockFile(const QString &base, const QString &owner) {
+	return QStringLiteral("%1.%2.lock").arg(base, owner);
+}
+
+QDateTime dateTimeFromJson(const QJsonValue &value) {
+	return value.isDouble() ? QDateTime::fromMSecsSinceEpoch(value.toInteger()) : QDateTime();
+}
+} // namespace
+
+SessionWriteQueue::SessionWriteQueue(Navigation &navigation, QString journalBase, QObject *parent)
+	: QObject(parent), navigation_(navigation), journalBase_(std::move(journalBase)) {
+	const QString owner = QString::number(QCoreApplication::applicationPid());
+	journalPath_ = journalFile(journalBase_, owner);
+
+	// Held until exit; others see it as free once this process is gone.
+	journalLock_ = std::make_unique<QLockFile>(lockFile(journalBase_, owner));
+	journalLock_->setStaleLockTime(0);
+	if (journalLock_->tryLock(0)) {
+		// A journal under this pid is left over from an earlier process.
+		replayJournal();
+		adoptOrphanedJournals();
+	}
+	if (!pending_.isEmpty()) {
+		startFlush();
+	}
+
+	// Queued after the replay above, so sessions still in a journal are
+	// written with their own scores before anything is rebuilt for them.
+	const QDateTime cutoff = QDateTime::currentDateTime().addSecs(-kAbandonedSessionSecs);
+	navigation_.asyncDao().run([cutoff](NavigationDAO &dao) {
+		try {
+			dao.closeAbandonedSessions(cutoff);
+		} catch (const std::exception &) {
+			// Tried again on the next start.
+		}
+	});
+}
+
+QString SessionWriteQueue::journalBaseFor(const QString &databasePath) {
+	// The scratch database is deleted at exit, so its journal is nobody
+	// else's to adopt.
+	if (NavConnectionManager::isTemporary(databasePath)) {
+		return QDir(QDir::tempPath()).filePath(
+			QStringLiteral("navdb-temp-%1.sessions").arg(QCoreApplication::applicationPid()));
+	}
+	return databasePath + QLatin1String(".sessions");
+}
+
+SessionWriteQueue::~SessionWriteQueue() {
+	// Whatever does not make it stays in the journal for the next start.
+	QString errorMessage;
+	flush(errorMessage);
+}
+
+bool SessionWriteQueue::enqueue(const QString &nickname, const SessionRecord &session, QString &errorMessage) {
+	Entry entry;
+	entry.nickname = nickname;
+	entry.session = session;
+	return append(std::move(entry), errorMessage);
+}
+
+bool SessionWriteQueue::enqueueAttempt(const QString &nickname,
+									   const QDateTime &sessionTimestamp,
+									   const QuestionAttempt &attempt,
+									   QString &errorMessage) {
+	Entry entry;
+	entry.nickname = nickname;
+	entry.session.timestamp = sessionTimestamp;
+	entry.session.attempts.push_back(attempt);
+	entry.attemptOnly = true;
+	return append(std::move(entry), errorMessage);
+}
+
+bool SessionWriteQueue::append(Entry entry, QString &errorMessage) {
+	entry.seq = nextSeq_++;
+	if (!appendToJournal(entry, errorMessage)) {
+		return false;
+	}
+
+	pending_.push_back(std::move(entry));
+	scheduleFlush();
+	return true;
+}
+
+QVector<SessionRecord> SessionWriteQueue::pendingFor(const QString &nickname) const {
+	QVector<SessionRecord> sessions;
+	for (const auto &entry : pending_) {
+		if (entry.nickname == nickname && !entry.attemptOnly) {
+			sessions.push_back(entry.session);
+		}
+	}
+
+	// Attempts of a session that is still running have nothing to join.
+	for (const auto &entry : pending_) {
+		if (entry.nickname != nickname || !entry.attemptOnly) {
+			continue;
+		}
+		for (auto &session : sessions) {
+			if (session.timestamp == entry.session.timestamp) {
+				session.attempts += entry.session.attempts;
+				break;
+			}
+		}
+	}
+	return sessions;
+}
+
+bool SessionWriteQueue::flush(QString &errorMessage) {
+	if (inFlight_.isRunning()) {
+		inFlight_.waitForFinished();
+	}
+	if (pending_.isEmpty()) {
+		return true;
+	}
+
+	// Entries the in-flight batch already wrote are written again; writeBatch() skips them.
+	const quint64 lastSeq = pending_.last().seq;
+	const QString error = submit(pending_).result();
+	if (!error.isEmpty()) {
+		errorMessage = error;
+		return false;
+	}
+
+	completeUpTo(lastSeq);
+	return true;
+}
+
+void SessionWriteQueue::scheduleFlush() {
+	if (flushScheduled_) {
+		return;
+	}
+	flushScheduled_ = true;
+	QTimer::singleShot(kFlushDelayMs, this, [this]() {
+		flushScheduled_ = false;
+		startFlush();
+	});
+}
+
+void SessionWriteQueue::startFlush() {
+	if (pending_.isEmpty()) {
+		return;
+	}
+	if (inFlight_.isRunning()) {
+		// One batch at a time; pick up the rest once it lands.
+		scheduleFlush();
+		return;
+	}
+
+	const quint64 lastSeq = pending_.last().seq;
+	inFlight_ = submit(pending_);
+	inFlight_.then(this, [this, lastSeq](const QString &error) {
+		if (!error.isEmpty()) {
+			// The entries stay pending and journaled; the next flush retries them.
+			emit flushFailed(error);
+			return;
+		}
+		completeUpTo(lastSeq);
+	});
+}
+
+QFuture<QString> SessionWriteQueue::submit(const QVector<Entry> &batch) {
+	return navigation_.asyncDao().run([batch](NavigationDAO &dao) { return writeBatch(dao, batch); });
+}
+
+void SessionWriteQueue::completeUpTo(quint64 seq) {
+	const auto firstKept = std::find_if(pending_.begin(), pending_.end(), [seq](const Entry &entry) {
+		return entry.seq > seq;
+	});
+	if (firstKept == pending_.begin()) {
+		return;
+	}
+	pending_.erase(pending_.begin(), firstKept);
+
+	QString errorMessage;
+	rewriteJournal(errorMessage);
+}
+
+QString SessionWriteQueue::writeBatch(NavigationDAO &dao, const QVector<Entry> &batch) {
+	// Runs on the database thread, whose connection dao also uses.
+	QString errorMessage;
+	QSqlDatabase db = NavConnectionManager::connection(dao.databasePath(), &errorMessage);
+	if (!db.isOpen()) {
+		return errorMessage;
+	}
+
+	try {
+		// Other instances may be writing to the same file; the DAO takes the
+		// lock up front and retries the whole batch while it is contended.
+		dao.writeTransaction("SessionWriteQueue.writeBatch", [&]() {
+			QSqlQuery userExists(db);
+			userExists.prepare(QStringLiteral("SELECT 1 FROM user WHERE nickName = ?"));
+
+			for (const auto &entry : batch) {
+				userExists.bindValue(0, entry.nickname);
+				bool ownerExists = false;
+				{
+					NavQueryTimer timer("SessionWriteQueue.userExists", userExists);
+					if (!userExists.exec()) {
+						throw NavDAOException(userExists.lastError().text());
+					}
+					ownerExists = userExists.next();
+					userExists.finish();
+				}
+				if (!ownerExists) {
+					// The account was removed meanwhile; its history went with it.
+					continue;
+				}
+
+				// A replayed or retried batch may already be partly committed.
+				if (!entry.attemptOnly && !dao.hasSession(entry.nickname, entry.session.timestamp)) {
+					dao.addSession(entry.nickname, Session(entry.session.timestamp, entry.session.hits, entry.session.faults));
+				}
+				QString attemptsError;
+				if (!UserManager::storeAttempts(db, entry.nickname, entry.session.timestamp, entry.session.attempts, attemptsError)) {
+					throw NavDAOException(attemptsError);
+				}
+			}
+		});
+	} catch (const std::exception &ex) {
+		return QString::fromUtf8(ex.what());
+	}
+	return {};
+}
+
+void SessionWriteQueue::replayJournal() {
+	for (auto &entry : readJournal(journalPath_)) {
+		nextSeq_ = std::max(nextSeq_, entry.seq + 1);
+		pending_.push_back(std::move(entry));
+	}
+}
+
+void SessionWriteQueue::adoptOrphanedJournals() {
+	const QFileInfo baseInfo(journalBase_);
+	const QDir dir = baseInfo.absoluteDir();
+	const QString prefix = baseInfo.fileName() + QLatin1Char('.');
+	const QString ownPath = QFileInfo(journalPath_).absoluteFilePath();
+
+	QStringList owners;
+	for (const QString &name : dir.entryList({prefix + QLatin1String("*.journal")}, QDir::Files)) {
+		const QString owner = name.mid(prefix.size(), name.size() - prefix.size() - int(qstrlen(".journal")));
+		if (!owner.isEmpty() && dir.absoluteFilePath(name) != ownPath) {
+			owners << owner;
+		}
+	}
+
+	bool adopted = false;
+	QVector<std::unique_ptr<QLockFile>> taken;
+	QStringList takenJournals;
+	const auto adopt = [&](const QString &journal, const QString &lockPath) {
+		auto lock = std::make_unique<QLockFile>(lockPath);
+		// A live owner's lock is never stale by age; a dead one's is.
+		lock->setStaleLockTime(0);
+		if (!lock->tryLock(0)) {
+			return;
+		}
+		for (auto &entry : readJournal(journal)) {
+			entry.seq = nextSeq_++;
+			pending_.push_back(std::move(entry));
+		}
+		takenJournals << journal;
+		taken.push_back(std::move(lock));
+		adopted = true;
+	};
+
+	for (const QString &owner : std::as_const(owners)) {
+		adopt(journalFile(journalBase_, owner), lockFile(journalBase_, owner));
+	}
+	// <base>.journal is the single shared journal of earlier builds.
+	const QString legacyJournal = journalBase_ + QLatin1String(".journal");
+	if (QFile::exists(legacyJournal)) {
+		adopt(legacyJournal, legacyJournal + QLatin1String(".lock"));
+	}
+	if (!adopted) {
+		return;
+	}
+
+	// The entries are in this instance's journal before the old files go,
+	// so a crash in between only replays them twice, which is harmless.
+	QString errorMessage;
+	if (!rewriteJournal(errorMessage)) {
+		return;
+	}
+	for (const QString &journal : std::as_const(takenJournals)) {
+		QFile::remove(journal);
+	}
+}
+
+QVector<SessionWriteQueue::Entry> SessionWriteQueue::readJournal(const QString &path) const {
+	QVector<Entry> entries;
+	QFile journal(path);
+	if (!journal.open(QIODevice::ReadOnly)) {
+		return entries;
+	}
+
+	while (!journal.atEnd()) {
+		const QByteArray line = journal.readLine().trimmed();
+		Entry entry;
+		// A torn last line from a crash mid-append is skipped.
+		if (line.isEmpty() || !decodeEntry(line, entry)) {
+			continue;
+		}
+		entries.push_back(std::move(entry));
+	}
+	return entries;
+}
+
+bool SessionWriteQueue::appendToJournal(const Entry &entry, QString &errorMessage) {
+	QFile journal(journalPath_);
+	if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+		errorMessage = tr("No se pudo guardar la sesión: %1").arg(journal.errorString());
+		return false;
+	}
+
+	const QByteArray line = encodeEntry(entry) + '\n';
+	if (journal.write(line) != line.size() || !syncToDisk(journal)) {
+		errorMessage = tr("No se pudo guardar la sesión: %1").arg(journal.errorString());
+		return false;
+	}
+	return true;
+}
+
+bool SessionWriteQueue::rewriteJournal(QString &errorMessage) {
+	if (pending_.isEmpty()) {
+		QFile::remove(journalPath_);
+		return true;
+	}
+
+	// Replaced atomically, so a crash leaves either the old or the new journal.
+	QSaveFile journal(journalPath_);
+	if (!journal.open(QIODevice::WriteOnly)) {
+		errorMessage = journal.errorString();
+		return false;
+	}
+	for (const auto &entry : pending_) {
+		journal.write(encodeEntry(entry) + '\n');
+	}
+	if (!journal.commit()) {
+		errorMessage = journal.errorString();
+		return false;
+	}
+	return true;
+}
+
+QByteArray SessionWriteQueue::encodeEntry(const Entry &entry) {
+	QJsonArray attempts;
+	for (const auto &attempt : entry.session.attempts) {
+		QJsonArray options;
+		for (const auto &option : attempt.options) {
+			options.push_back(QJsonObject{{"text", option.text}, {"correct", option.correct}});
+		}
+		attempts.push_back(QJsonObject{
+			{"id", attempt.id},
+			{"ts", millisOrNull(attempt.timestamp)},
+			{"problemId", attempt.problemId},
+			{"question", attempt.question},
+			{"selected", attempt.selectedAnswer},
+			{"answer", attempt.correctAnswer},
+			{"correct", attempt.correct},
+			{"selectedIndex", attempt.selectedIndex},
+			{"options", options},
+		});
+	}
+
+	QJsonObject object{
+		{"seq", static_cast<qint64>(entry.seq)},
+		{"nick", entry.nickname},
+		{"ts", millisOrNull(entry.session.timestamp)},
+		{"attempts", attempts},
+	};
+	if (entry.attemptOnly) {
+		object.insert(QLatin1String("kind"), QLatin1String("attempt"));
+	} else {
+		object.insert(QLatin1String("hits"), entry.session.hits);
+		object.insert(QLatin1String("faults"), entry.session.faults);
+	}
+	return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+bool SessionWriteQueue::decodeEntry(const QByteArray &line, Entry &entry) {
+	QJsonParseError parseError;
+	const QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+	if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+		return false;
+	}
+
+	const QJsonObject object = document.object();
+	entry.seq = static_cast<quint64>(object.value(QLatin1String("seq")).toInteger());
+	entry.nickname = object.value(QLatin1String("nick")).toString();
+	entry.session.timestamp = dateTimeFromJson(object.value(QLatin1String("ts")));
+	entry.session.hits = object.value(QLatin1String("hits")).toInt();
+	entry.session.faults = object.value(QLatin1String("faults")).toInt();
+	entry.attemptOnly = object.value(QLatin1String("kind")).toString() == QLatin1String("attempt");
+	if (entry.nickname.isEmpty() || !entry.session.timestamp.isValid()) {
+		return false;
+	}
+
+	const QJsonArray attempts = object.value(QLatin1String("attempts")).toArray();
+	for (const auto &value : attempts) {
+		const QJsonObject a = value.toObject();
+		QuestionAttempt attempt;
+		attempt.id = a.value(QLatin1String("id")).toString();
+		attempt.timestamp = dateTimeFromJson(a.value(QLatin1String("ts")));
+		attempt.problemId = a.value(QLatin1String("problemId")).toInt(-1);
+		attempt.question = a.value(QLatin1String("question")).toString();
+		attempt.selectedAnswer = a.value(QLatin1String("selected")).toString();
+		attempt.correctAnswer = a.value(QLatin1String("answer")).toString();
+		attempt.correct = a.value(QLatin1String("correct")).toBool();
+		attempt.selectedIndex = a.value(QLatin1String("selectedIndex")).toInt(-1);
+		for (const auto &optionValue : a.value(QLatin1String("options")).toArray()) {
+			const QJsonObject o = optionValue.toObject();
+			attempt.options.push_back(AttemptOption{o.value(QLatin1String("text")).toString(),
+													o.value(QLatin1String("correct")).toBool()});
+		}
+		if (attempt.id.isEmpty()) {
+			attempt.id = legacyAttemptId(entry.nickname, entry.session.timestamp, attempt);
+		}
+		entry.session.attempts.push_back(std::move(attempt));
+	}
+	return true;
+}
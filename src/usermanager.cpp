@@ -1,23 +1,22 @@
 #include "usermanager.h"
+#include "navconnectionmanager.h"
+#include "navoptionscodec.h"
+#include "navquerystats.h"
 
-#include <QCoreApplication>
+#include <algorithm>
 #include <exception>
 #include <QCryptographicHash>
 #include <QDateTime>
 #include <QDir>
-#include <QFile>
 #include <QFileInfo>
 #include <QImage>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QRandomGenerator>
 #include <QStringList>
+#include <QUuid>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
-#include <QUuid>
 
 namespace {
 constexpr auto kDefaultAvatarResource = ":/resources/images/default_avatar.svg";
@@ -30,24 +29,63 @@ QString sessionKey(const QDateTime &timestamp) {
 QString attemptKey(const QDateTime &timestamp) {
 	return timestamp.isValid() ? timestamp.toString(Qt::ISODateWithMs) : QString();
 }
+
+QString newAttemptId() {
+	return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
 } // namespace
 
 UserManager::UserManager(Navigation &navigation, QString avatarsDirectory)
-	: navigation_(navigation), avatarsDirectory_(std::move(avatarsDirectory)) {
+	: navigation_(navigation),
+	  avatarsDirectory_(std::move(avatarsDirectory)),
+	  avatarStore_(avatarsDirectory_),
+	  writeQueue_(navigation, SessionWriteQueue::journalBaseFor(navigation.dao().databasePath())) {
 	if (!avatarsDirectory_.isEmpty()) {
 		QDir().mkpath(avatarsDirectory_);
 	}
-	databasePath_ = resolveDatabasePath();
+	databasePath_ = navigation_.dao().databasePath();
 }
 
 bool UserManager::load() {
-	users_.clear();
-	navigation_.reload();
+	const Navigation::ReloadResult changes = navigation_.reload();
+
+	if (!loaded_ || changes.full) {
+		users_.clear();
+		const auto &navUsers = navigation_.users();
+		users_.reserve(navUsers.size());
+		for (auto it = navUsers.constBegin(); it != navUsers.constEnd(); ++it) {
+			users_.push_back(makeRecordFromNavUser(it.value()));
+		}
+		loaded_ = true;
+		return true;
+	}
+
+	// Only the users reported by the reload are rebuilt; users_ keeps the
+	// nickname order of Navigation::users().
+	const auto byNickname = [](const UserRecord &record, const QString &nickname) {
+		return record.nickname < nickname;
+	};
+
+	for (const QString &nickname : changes.removedUsers) {
+		const auto it = std::lower_bound(users_.begin(), users_.end(), nickname, byNickname);
+		if (it != users_.end() && it->nickname == nickname) {
+			users_.erase(it);
+		}
+		avatarPaths_.remove(nickname);
+	}
 
-	const auto &navUsers = navigation_.users();
-	users_.reserve(navUsers.size());
-	for (auto it = navUsers.constBegin(); it != navUsers.constEnd(); ++it) {
-		users_.push_back(makeRecordFromNavUser(it.value()));
+	for (const QString &nickname : changes.changedUsers) {
+		const User *navUser = navigation_.findUser(nickname);
+		if (!navUser) {
+			continue;
+		}
+		UserRecord record = makeRecordFromNavUser(*navUser);
+		const auto it = std::lower_bound(users_.begin(), users_.end(), nickname, byNickname);
+		if (it != users_.end() && it->nickname == nickname) {
+			*it = std::move(record);
+		} else {
+			users_.insert(it, std::move(record));
+		}
 	}
 
 	return true;
@@ -59,9 +97,60 @@ bool UserManager::registerUser(const QString &nickname,
 							   const QDate &birthdate,
 							   const QString &avatarSource,
 							   QString &errorMessage) {
+	std::optional<User> navUser = prepareNewUser(nickname, email, password, birthdate, avatarSource, errorMessage);
+	if (!navUser) {
+		return false;
+	}
+
+	try {
+		navigation_.addUser(*navUser);
+	} catch (const std::exception &ex) {
+		errorMessage = QObject::tr("No se pudo registrar al usuario: %1").arg(QString::fromUtf8(ex.what()));
+		return false;
+	}
+
+	return load();
+}
+
+QFuture<QString> UserManager::loadAsync(QObject *context) {
+	return navigation_.loadAsync(context).then(context, [this](const QString &error) {
+		if (!error.isEmpty()) {
+			return error;
+		}
+		// Navigation is loaded now, so this only builds the records.
+		return load() ? QString() : QObject::tr("No se pudo cargar la información de usuarios.");
+	});
+}
+
+QFuture<QString> UserManager::registerUserAsync(const QString &nickname,
+												const QString &email,
+												const QString &password,
+												const QDate &birthdate,
+												const QString &avatarSource,
+												QObject *context) {
+	QString errorMessage;
+	const std::optional<User> navUser = prepareNewUser(nickname, email, password, birthdate, avatarSource, errorMessage);
+	if (!navUser) {
+		return QtFuture::makeReadyFuture(errorMessage);
+	}
+
+	return navigation_.addUserAsync(*navUser, context).then(context, [this](const QString &error) {
+		if (!error.isEmpty()) {
+			return QObject::tr("No se pudo registrar al usuario: %1").arg(error);
+		}
+		return load() ? QString() : QObject::tr("No se pudo cargar la información de usuarios.");
+	});
+}
+
+std::optional<User> UserManager::prepareNewUser(const QString &nickname,
+												const QString &email,
+												const QString &password,
+												const QDate &birthdate,
+												const QString &avatarSource,
+												QString &errorMessage) const {
 	if (navigation_.findUser(nickname)) {
 		errorMessage = QObject::tr("El nombre de usuario ya está en uso.");
-		return false;
+		return std::nullopt;
 	}
 
 	UserRecord user;
@@ -73,30 +162,21 @@ bool UserManager::registerUser(const QString &nickname,
 
 	if (!avatarSource.isEmpty()) {
 		QString avatarError;
-		user.avatarPath = ensureAvatarStored(nickname, avatarSource, avatarError);
+		user.avatarPath = ensureAvatarStored(avatarSource, avatarError);
 		if (user.avatarPath.isEmpty()) {
 			errorMessage = avatarError;
-			return false;
+			return std::nullopt;
 		}
 	} else {
 		user.avatarPath = QString::fromLatin1(kDefaultAvatarResource);
 	}
 
 	const QImage avatarImage = loadAvatarImage(resolvedAvatarPath(user.avatarPath));
-	User navUser(user.nickname,
-				 user.email,
-				 encodePasswordPayload(user.salt, user.passwordHash),
-				 avatarImage,
-				 user.birthdate);
-
-	try {
-		navigation_.addUser(navUser);
-	} catch (const std::exception &ex) {
-		errorMessage = QObject::tr("No se pudo registrar al usuario: %1").arg(QString::fromUtf8(ex.what()));
-		return false;
-	}
-
-	return load();
+	return User(user.nickname,
+				user.email,
+				encodePasswordPayload(user.salt, user.passwordHash),
+				avatarImage,
+				user.birthdate);
 }
 
 std::optional<UserRecord> UserManager::authenticate(const QString &nickname,
@@ -111,7 +191,7 @@ std::optional<UserRecord> UserManager::authenticate(const QString &nickname,
 	const auto &user = users_.at(index);
 	const auto hash = hashPassword(password, user.salt);
 	if (!hash.isEmpty() && hash == user.passwordHash) {
-		return user;
+		return withAvatar(user);
 	}
 
 	errorMessage = QObject::tr("Usuario o contraseña incorrectos.");
@@ -141,13 +221,14 @@ bool UserManager::updateUser(const QString &nickname,
 
 	if (!avatarSource.isEmpty()) {
 		QString avatarError;
-		const auto storedPath = ensureAvatarStored(nickname, avatarSource, avatarError);
+		const auto storedPath = ensureAvatarStored(avatarSource, avatarError);
 		if (storedPath.isEmpty()) {
 			errorMessage = avatarError;
 			return false;
 		}
 		const QImage avatarImage = loadAvatarImage(resolvedAvatarPath(storedPath));
 		navUser->setAvatar(avatarImage);
+		avatarPaths_.remove(nickname);
 	}
 
 	try {
@@ -168,20 +249,130 @@ bool UserManager::appendSession(const QString &nickname,
 		return false;
 	}
 
-	Session navSession(session.timestamp, session.hits, session.faults);
+	// Attempts that already have an id went through recordAttempt(); only
+	// the session row and any attempt not recorded yet are left to write.
+	SessionRecord stored = session;
+	SessionRecord unwritten = session;
+	unwritten.attempts.clear();
+	for (auto &attempt : stored.attempts) {
+		if (attempt.id.isEmpty()) {
+			attempt.id = newAttemptId();
+			unwritten.attempts.push_back(attempt);
+		}
+	}
+
+	// Journaled and written later on the database thread; the in-memory
+	// record is updated now so callers see the session straight away.
+	if (!writeQueue_.enqueue(nickname, unwritten, errorMessage)) {
+		return false;
+	}
+
+	const int index = findIndex(nickname);
+	if (index != -1) {
+		users_[index].sessions.push_back(std::move(stored));
+	}
+	return true;
+}
+
+bool UserManager::recordAttempt(const QString &nickname,
+								const QDateTime &sessionTimestamp,
+								QuestionAttempt &attempt,
+								QString &errorMessage) {
+	if (!navigation_.findUser(nickname)) {
+		errorMessage = QObject::tr("El usuario no existe.");
+		return false;
+	}
 
+	if (attempt.id.isEmpty()) {
+		attempt.id = newAttemptId();
+	}
+	if (!writeQueue_.enqueueAttempt(nickname, sessionTimestamp, attempt, errorMessage)) {
+		// Left without an id, appendSession() writes it with the session instead.
+		attempt.id.clear();
+		return false;
+	}
+	return true;
+}
+
+bool UserManager::flushPendingSessions(QString &errorMessage) {
+	return writeQueue_.flush(errorMessage);
+}
+
+SessionCursor UserManager::openSessionCursor(const QString &nickname,
+											 const QDateTime &from,
+											 const QDateTime &to) const {
+	SessionCursor cursor;
+	cursor.nickname = nickname;
+	cursor.from = from;
+	cursor.to = to;
+	return cursor;
+}
+
+bool UserManager::fetchSessions(SessionCursor &cursor,
+								int limit,
+								QVector<SessionRecord> &out,
+								QString &errorMessage) const {
+	if (cursor.atEnd) {
+		return true;
+	}
+
+	NavigationDAO::SessionPage page;
 	try {
-		navigation_.addSession(nickname, navSession);
+		page = navigation_.dao().loadSessionPage(cursor.nickname, cursor.position, limit, cursor.from, cursor.to);
 	} catch (const std::exception &ex) {
-		errorMessage = QObject::tr("No se pudo guardar la sesión: %1").arg(QString::fromUtf8(ex.what()));
+		errorMessage = QObject::tr("No se pudieron cargar las sesiones: %1").arg(QString::fromUtf8(ex.what()));
 		return false;
 	}
 
-	if (!storeSessionAttempts(nickname, session, errorMessage)) {
+	// Attempts are left out: a page is listed as a whole but its attempts are
+	// only shown for the selected session, see sessionAttempts().
+	out.reserve(out.size() + page.sessions.size());
+	for (const auto &navSession : page.sessions) {
+		SessionRecord session;
+		session.timestamp = navSession.timeStamp();
+		session.hits = navSession.hits();
+		session.faults = navSession.faults();
+		out.push_back(std::move(session));
+	}
+
+	cursor.position = page.next;
+	cursor.atEnd = !page.hasMore;
+	return true;
+}
+
+bool UserManager::sessionAttempts(const QString &nickname,
+								  const QDateTime &sessionTimestamp,
+								  QVector<QuestionAttempt> &out,
+								  QString &errorMessage) const {
+	if (!ensureHistoryStorage(errorMessage)) {
 		return false;
 	}
+	out = loadSessionAttempts(nickname, sessionTimestamp);
+	return true;
+}
 
-	return load();
+std::optional<NavigationDAO::SessionTotals> UserManager::sessionTotals(const SessionCursor &cursor,
+																	   QString &errorMessage) const {
+	try {
+		return navigation_.dao().sessionTotals(cursor.nickname, cursor.from, cursor.to);
+	} catch (const std::exception &ex) {
+		errorMessage = QObject::tr("No se pudieron cargar las sesiones: %1").arg(QString::fromUtf8(ex.what()));
+		return std::nullopt;
+	}
+}
+
+bool UserManager::dailyStats(const QString &nickname,
+							 const QDate &from,
+							 const QDate &to,
+							 QVector<NavigationDAO::DailyStats> &out,
+							 QString &errorMessage) const {
+	try {
+		out = navigation_.dao().loadDailyStats(nickname, from, to);
+	} catch (const std::exception &ex) {
+		errorMessage = QObject::tr("No se pudieron cargar las estadísticas: %1").arg(QString::fromUtf8(ex.what()));
+		return false;
+	}
+	return true;
 }
 
 std::optional<UserRecord> UserManager::getUser(const QString &nickname) const {
@@ -189,7 +380,7 @@ std::optional<UserRecord> UserManager::getUser(const QString &nickname) const {
 	if (index == -1) {
 		return std::nullopt;
 	}
-	return users_.at(index);
+	return withAvatar(users_.at(index));
 }
 
 QVector<UserRecord> UserManager::allUsers() const {
@@ -203,6 +394,11 @@ QString UserManager::resolvedAvatarPath(const QString &storedPath) const {
 	return avatarsDirectory_.isEmpty() ? storedPath : avatarsDirectory_ + QLatin1Char('/') + storedPath;
 }
 
+QString UserManager::avatarThumbnailPath(const QString &storedPath, int size) const {
+	const QString thumbnail = avatarStore_.thumbnailPath(storedPath, size);
+	return thumbnail.isEmpty() ? resolvedAvatarPath(storedPath) : thumbnail;
+}
+
 QString UserManager::hashPassword(const QString &password, const QString &salt) const {
 	const auto salted = (salt + password).toUtf8();
 	return QString::fromLatin1(QCryptographicHash::hash(salted, QCryptographicHash::Sha256).toHex());
@@ -212,30 +408,17 @@ QString UserManager::generateSalt() const {
 	return QString::number(QRandomGenerator::global()->generate64(), 16);
 }
 
-QString UserManager::ensureAvatarStored(const QString &nickname,
-										const QString &sourcePath,
-										QString &errorMessage) const {
+QString UserManager::ensureAvatarStored(const QString &sourcePath, QString &errorMessage) const {
 	if (sourcePath.startsWith(QLatin1String(":/")) || avatarsDirectory_.isEmpty()) {
 		return sourcePath;
 	}
 
-	QFile sourceFile(sourcePath);
-	if (!sourceFile.exists()) {
+	if (!QFileInfo::exists(sourcePath)) {
 		errorMessage = QObject::tr("No se encuentra la imagen seleccionada.");
 		return {};
 	}
 
-	const QString extension = QFileInfo(sourceFile).suffix();
-	const QString targetName = nickname + QLatin1String("_") + QString::number(QDateTime::currentSecsSinceEpoch()) + QLatin1String(".") + extension;
-	const QString targetPath = avatarsDirectory_ + QLatin1Char('/') + targetName;
-
-	if (!sourceFile.copy(targetPath)) {
-		errorMessage = QObject::tr("No se pudo copiar la imagen seleccionada.");
-		return {};
-	}
-
-	QFile::setPermissions(targetPath, QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther | QFile::WriteUser);
-	return targetName;
+	return avatarStore_.store(QImage(sourcePath), errorMessage);
 }
 
 int UserManager::findIndex(const QString &nickname) const {
@@ -268,18 +451,37 @@ UserRecord UserManager::makeRecordFromNavUser(const User &navUser) const {
 	record.email = navUser.email();
 	decodePasswordPayload(navUser.password(), record.salt, record.passwordHash);
 	record.birthdate = navUser.birthdate();
-	record.avatarPath = persistAvatarImage(record.nickname, navUser.avatar());
-
-	QVector<Session> sessions = navUser.sessions();
-	if (sessions.isEmpty()) {
-		sessions = navigation_.dao().loadSessionsFor(navUser.nickName());
-	}
 
+	const QVector<Session> &sessions = navUser.sessions();
 	record.sessions.reserve(sessions.size());
 	for (const auto &navSession : sessions) {
 		record.sessions.push_back(makeRecordFromNavSession(record.nickname, navSession));
 	}
 
+	// Sessions still waiting in the write queue are not in the database yet.
+	for (auto pending : writeQueue_.pendingFor(record.nickname)) {
+		const bool stored = std::any_of(record.sessions.cbegin(), record.sessions.cend(), [&](const SessionRecord &s) {
+			return s.timestamp == pending.timestamp;
+		});
+		if (stored) {
+			continue;
+		}
+
+		// Attempts are flushed ahead of their session and may already be stored.
+		for (auto &attempt : loadSessionAttempts(record.nickname, pending.timestamp)) {
+			const bool queued = std::any_of(pending.attempts.cbegin(), pending.attempts.cend(), [&](const QuestionAttempt &a) {
+				return a.id == attempt.id;
+			});
+			if (!queued) {
+				pending.attempts.push_back(std::move(attempt));
+			}
+		}
+		std::sort(pending.attempts.begin(), pending.attempts.end(), [](const QuestionAttempt &a, const QuestionAttempt &b) {
+			return a.timestamp < b.timestamp;
+		});
+		record.sessions.push_back(std::move(pending));
+	}
+
 	return record;
 }
 
@@ -292,19 +494,32 @@ SessionRecord UserManager::makeRecordFromNavSession(const QString &nickname, con
 	return session;
 }
 
-QString UserManager::persistAvatarImage(const QString &nickname, const QImage &image) const {
-	if (image.isNull() || avatarsDirectory_.isEmpty()) {
-		return QString::fromLatin1(kDefaultAvatarResource);
+UserRecord UserManager::withAvatar(UserRecord record) const {
+	if (!record.avatarPath.isEmpty()) {
+		return record;
+	}
+
+	// Avatars are decoded and exported only for the users that are actually shown.
+	const auto cached = avatarPaths_.constFind(record.nickname);
+	if (cached != avatarPaths_.constEnd()) {
+		record.avatarPath = cached.value();
+		return record;
 	}
 
-	const QString fileName = nickname + QLatin1String("_navdb.png");
-	const QString absolutePath = avatarsDirectory_ + QLatin1Char('/') + fileName;
-	if (image.save(absolutePath, "PNG")) {
-		QFile::setPermissions(absolutePath, QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther | QFile::WriteUser);
-		return fileName;
+	const User *navUser = navigation_.findUser(record.nickname);
+	record.avatarPath = persistAvatarImage(navUser ? navUser->avatar() : QImage());
+	avatarPaths_.insert(record.nickname, record.avatarPath);
+	return record;
+}
+
+QString UserManager::persistAvatarImage(const QImage &image) const {
+	if (image.isNull() || avatarsDirectory_.isEmpty()) {
+		return QString::fromLatin1(kDefaultAvatarResource);
 	}
 
-	return QString::fromLatin1(kDefaultAvatarResource);
+	QString errorMessage;
+	const QString fileName = avatarStore_.store(image, errorMessage);
+	return fileName.isEmpty() ? QString::fromLatin1(kDefaultAvatarResource) : fileName;
 }
 
 QImage UserManager::loadAvatarImage(const QString &path) const {
@@ -322,49 +537,6 @@ QImage UserManager::loadAvatarImage(const QString &path) const {
 	return image;
 }
 
-QString UserManager::resolveDatabasePath() const {
-	QDir appDir(QCoreApplication::applicationDirPath());
-	const QString localPath = appDir.absoluteFilePath(QStringLiteral("navdb.sqlite"));
-	
-	// 1. Check common relative paths from build directory
-	QStringList probes{
-		QStringLiteral("navdb.sqlite"),
-		QStringLiteral("../navdb.sqlite"),
-		QStringLiteral("../../navdb.sqlite"),
-		QStringLiteral("../../../navdb.sqlite")
-	};
-
-	for (const auto &probe : probes) {
-		const QString candidate = appDir.absoluteFilePath(probe);
-		if (QFileInfo::exists(candidate)) {
-			return candidate;
-		}
-	}
-
-	// 2. Walk up the directory tree to find the project root
-	QDir walker(appDir);
-	for (int depth = 0; depth < 5 && walker.cdUp(); ++depth) {
-		// If we find the project folder "IHM_PER_QT", use the DB inside it
-		if (walker.exists(QStringLiteral("IHM_PER_QT"))) {
-			return walker.absoluteFilePath(QStringLiteral("IHM_PER_QT/navdb.sqlite"));
-		}
-
-		// Also check if we are already IN the project folder (or parent) and the DB is here
-		QStringList candidates = {
-			QStringLiteral("navdb.sqlite"),
-			QStringLiteral("navdb/navdb.sqlite")
-		};
-		for (const auto &fname : candidates) {
-			const QString candidate = walker.absoluteFilePath(fname);
-			if (QFileInfo::exists(candidate)) {
-				return candidate;
-			}
-		}
-	}
-
-	return localPath;
-}
-
 bool UserManager::ensureHistoryStorage(QString &errorMessage) const {
 	if (historyStorageReady_) {
 		return true;
@@ -375,43 +547,10 @@ bool UserManager::ensureHistoryStorage(QString &errorMessage) const {
 		return false;
 	}
 
-	bool ready = true;
-	QString localError;
-	const QString connection = historyConnectionName();
-	{
-		QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
-		db.setDatabaseName(databasePath_);
-		if (!db.open()) {
-			ready = false;
-			localError = db.lastError().text();
-		} else {
-			QSqlQuery query(db);
-			const QString createSql = QStringLiteral(
-				"CREATE TABLE IF NOT EXISTS %1 ("
-				"userNickName TEXT NOT NULL,"
-				"sessionTimestamp TEXT NOT NULL,"
-				"attemptTimestamp TEXT,"
-				"problemId INTEGER,"
-				"question TEXT,"
-				"selectedAnswer TEXT,"
-				"correctAnswer TEXT,"
-				"wasCorrect INTEGER NOT NULL,"
-				"optionsJson TEXT,"
-				"selectedIndex INTEGER,"
-				"PRIMARY KEY(userNickName, sessionTimestamp, attemptTimestamp, question))"
-			).arg(QString::fromLatin1(kHistoryTableName));
-
-			if (!query.exec(createSql)) {
-				ready = false;
-				localError = query.lastError().text();
-			}
-		}
-		db.close();
-	}
-	QSqlDatabase::removeDatabase(connection);
-
-	if (!ready) {
-		errorMessage = localError;
+	// The question_history schema is created and migrated by NavigationDAO;
+	// here we only make sure this thread can reach it.
+	const QSqlDatabase db = NavConnectionManager::connection(databasePath_, &errorMessage);
+	if (!db.isOpen()) {
 		return false;
 	}
 
@@ -426,205 +565,192 @@ QVector<QuestionAttempt> UserManager::loadSessionAttempts(const QString &nicknam
 		return attempts;
 	}
 
-	const QString connection = historyConnectionName();
-	{
-		QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
-		db.setDatabaseName(databasePath_);
-		if (db.open()) {
-			QSqlQuery query(db);
-			query.prepare(QStringLiteral(
-				"SELECT attemptTimestamp, problemId, question, selectedAnswer, correctAnswer, wasCorrect, optionsJson, selectedIndex "
-				"FROM %1 WHERE userNickName = ? AND sessionTimestamp = ? ORDER BY attemptTimestamp" ).arg(QString::fromLatin1(kHistoryTableName)));
-			query.addBindValue(nickname);
-			query.addBindValue(sessionKey(sessionTimestamp));
-
-			if (query.exec()) {
-				while (query.next()) {
-					QuestionAttempt attempt;
-					attempt.timestamp = QDateTime::fromString(query.value(0).toString(), Qt::ISODateWithMs);
-					attempt.problemId = query.value(1).toInt();
-					attempt.question = query.value(2).toString();
-					attempt.selectedAnswer = query.value(3).toString();
-					attempt.correctAnswer = query.value(4).toString();
-					attempt.correct = query.value(5).toInt() == 1;
-					attempt.selectedIndex = query.value(7).isNull() ? -1 : query.value(7).toInt();
-
-					const auto optionsDoc = QJsonDocument::fromJson(query.value(6).toByteArray());
-					if (optionsDoc.isArray()) {
-						const auto optionsArray = optionsDoc.array();
-						for (const auto &optionValue : optionsArray) {
-							if (!optionValue.isObject()) {
-								continue;
-							}
-							const auto optionObj = optionValue.toObject();
-							AttemptOption option;
-							option.text = optionObj.value("text").toString();
-							option.correct = optionObj.value("correct").toBool();
-							attempt.options.push_back(option);
-						}
-					}
-
-					if (attempt.options.isEmpty()) {
-						if (!attempt.selectedAnswer.isEmpty()) {
-							AttemptOption option;
-							option.text = attempt.selectedAnswer;
-							option.correct = attempt.correct;
-							attempt.options.push_back(option);
-						}
-						if (!attempt.correctAnswer.isEmpty() && attempt.correctAnswer != attempt.selectedAnswer) {
-							AttemptOption option;
-							option.text = attempt.correctAnswer;
-							option.correct = true;
-							attempt.options.push_back(option);
-						}
-					}
-
-					attempts.push_back(std::move(attempt));
-				}
+	QSqlDatabase db = NavConnectionManager::connection(databasePath_);
+	if (!db.isOpen()) {
+		return attempts;
+	}
+
+	// One range of idx_history_session_time: sessions and their attempts share
+	// the integer timestamp since migration 10, so there is no fallback match.
+	QSqlQuery query(db);
+	query.prepare(QStringLiteral(
+		"SELECT attemptTimestamp, problemId, question, selectedAnswer, correctAnswer, wasCorrect, optionsJson, selectedIndex, attemptTimestampMs, attemptId, correctIndex "
+		"FROM %1 WHERE userNickName = ? AND sessionTimestampMs = ? ORDER BY attemptTimestampMs" ).arg(QString::fromLatin1(kHistoryTableName)));
+	query.addBindValue(nickname);
+	query.addBindValue(sessionTimestamp.toMSecsSinceEpoch());
+
+	NavQueryTimer timer("UserManager.loadSessionAttempts", query);
+	if (query.exec()) {
+		while (query.next()) {
+			timer.addRow();
+			QuestionAttempt attempt;
+			attempt.timestamp = query.value(8).isNull()
+									? QDateTime::fromString(query.value(0).toString(), Qt::ISODateWithMs)
+									: QDateTime::fromMSecsSinceEpoch(query.value(8).toLongLong());
+			attempt.problemId = query.value(1).toInt();
+			attempt.question = query.value(2).toString();
+			attempt.selectedAnswer = query.value(3).toString();
+			attempt.correctAnswer = query.value(4).toString();
+			attempt.correct = query.value(5).toInt() == 1;
+			attempt.selectedIndex = query.value(7).isNull() ? -1 : query.value(7).toInt();
+			attempt.id = query.value(9).toString();
+			if (query.value(2).isNull()) {
+				resolveStoredProblem(attempt, query.value(10).isNull() ? -1 : query.value(10).toInt());
 			}
 
-		// If no attempts were found using the exact session timestamp (may lack ms),
-		// try a looser match by using the ISO date without milliseconds as a prefix.
-		if (attempts.isEmpty()) {
-			const QString prefix = sessionKey(sessionTimestamp).section('.', 0, 0); // drop ms if present
-			query.prepare(QStringLiteral(
-				"SELECT attemptTimestamp, problemId, question, selectedAnswer, correctAnswer, wasCorrect, optionsJson, selectedIndex "
-				"FROM %1 WHERE userNickName = ? AND sessionTimestamp LIKE ? ORDER BY attemptTimestamp" ).arg(QString::fromLatin1(kHistoryTableName)));
-			query.addBindValue(nickname);
-			query.addBindValue(prefix + QLatin1Char('%'));
-
-			if (query.exec()) {
-				while (query.next()) {
-					QuestionAttempt attempt;
-					attempt.timestamp = QDateTime::fromString(query.value(0).toString(), Qt::ISODateWithMs);
-					attempt.problemId = query.value(1).toInt();
-					attempt.question = query.value(2).toString();
-					attempt.selectedAnswer = query.value(3).toString();
-					attempt.correctAnswer = query.value(4).toString();
-					attempt.correct = query.value(5).toInt() == 1;
-					attempt.selectedIndex = query.value(7).isNull() ? -1 : query.value(7).toInt();
-
-					const auto optionsDoc = QJsonDocument::fromJson(query.value(6).toByteArray());
-					if (optionsDoc.isArray()) {
-						const auto optionsArray = optionsDoc.array();
-						for (const auto &optionValue : optionsArray) {
-							if (!optionValue.isObject()) {
-								continue;
-							}
-							const auto optionObj = optionValue.toObject();
-							AttemptOption option;
-							option.text = optionObj.value("text").toString();
-							option.correct = optionObj.value("correct").toBool();
-							attempt.options.push_back(option);
-						}
-					}
-
-					if (attempt.options.isEmpty()) {
-						if (!attempt.selectedAnswer.isEmpty()) {
-							AttemptOption option;
-							option.text = attempt.selectedAnswer;
-							option.correct = attempt.correct;
-							attempt.options.push_back(option);
-						}
-						if (!attempt.correctAnswer.isEmpty() && attempt.correctAnswer != attempt.selectedAnswer) {
-							AttemptOption option;
-							option.text = attempt.correctAnswer;
-							option.correct = true;
-							attempt.options.push_back(option);
-						}
-					}
-
-					attempts.push_back(std::move(attempt));
+			const auto storedOptions = NavOptionsCodec::decode(query.value(6).toByteArray());
+			for (const auto &stored : storedOptions) {
+				AttemptOption option;
+				option.text = stored.text();
+				option.correct = stored.validity();
+				attempt.options.push_back(option);
+			}
+
+			if (attempt.options.isEmpty()) {
+				if (!attempt.selectedAnswer.isEmpty()) {
+					AttemptOption option;
+					option.text = attempt.selectedAnswer;
+					option.correct = attempt.correct;
+					attempt.options.push_back(option);
+				}
+				if (!attempt.correctAnswer.isEmpty() && attempt.correctAnswer != attempt.selectedAnswer) {
+					AttemptOption option;
+					option.text = attempt.correctAnswer;
+					option.correct = true;
+					attempt.options.push_back(option);
 				}
 			}
+
+			attempts.push_back(std::move(attempt));
 		}
-		}
-		db.close();
 	}
-	QSqlDatabase::removeDatabase(connection);
 
 	return attempts;
 }
 
-bool UserManager::storeSessionAttempts(const QString &nickname,
-									   const SessionRecord &session,
-									   QString &errorMessage) const {
-	if (session.attempts.isEmpty()) {
-		return true;
+void UserManager::resolveStoredProblem(QuestionAttempt &attempt, int correctIndex) const {
+	const Problem *problem = navigation_.findProblem(attempt.problemId);
+	if (!problem) {
+		return;
 	}
 
-	if (!ensureHistoryStorage(errorMessage)) {
-		return false;
+	attempt.question = problem->text();
+	const QVector<Answer> &answers = problem->answers();
+	for (int i = 0; i < answers.size(); ++i) {
+		AttemptOption option;
+		option.text = answers.at(i).text();
+		option.correct = answers.at(i).validity();
+		attempt.options.push_back(option);
+		if (correctIndex < 0 && option.correct) {
+			correctIndex = i;
+		}
+	}
+	if (attempt.selectedIndex >= 0 && attempt.selectedIndex < answers.size()) {
+		attempt.selectedAnswer = answers.at(attempt.selectedIndex).text();
 	}
+	if (correctIndex >= 0 && correctIndex < answers.size()) {
+		attempt.correctAnswer = answers.at(correctIndex).text();
+	}
+}
 
-	const QString connection = historyConnectionName();
-	bool success = true;
-	{
-		QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
-		db.setDatabaseName(databasePath_);
-		if (!db.open()) {
-			errorMessage = db.lastError().text();
-			success = false;
-		} else {
-			db.transaction();
-			QSqlQuery deleteQuery(db);
-			deleteQuery.prepare(QStringLiteral("DELETE FROM %1 WHERE userNickName = ? AND sessionTimestamp = ?")
-									.arg(QString::fromLatin1(kHistoryTableName)));
-			deleteQuery.addBindValue(nickname);
-			deleteQuery.addBindValue(sessionKey(session.timestamp));
-			if (!deleteQuery.exec()) {
-				errorMessage = deleteQuery.lastError().text();
-				db.rollback();
-				success = false;
-			} else {
-				QSqlQuery insertQuery(db);
-				insertQuery.prepare(QStringLiteral(
-					"INSERT OR REPLACE INTO %1 "
-					"(userNickName, sessionTimestamp, attemptTimestamp, problemId, question, selectedAnswer, correctAnswer, wasCorrect, optionsJson, selectedIndex) "
-					"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
-				).arg(QString::fromLatin1(kHistoryTableName)));
-
-				for (const auto &attempt : session.attempts) {
-					QJsonArray optionsArray;
-					for (const auto &option : attempt.options) {
-						optionsArray.push_back(QJsonObject{{"text", option.text}, {"correct", option.correct}});
-					}
-
-					insertQuery.bindValue(0, nickname);
-					insertQuery.bindValue(1, sessionKey(session.timestamp));
-					insertQuery.bindValue(2, attemptKey(attempt.timestamp));
-					insertQuery.bindValue(3, attempt.problemId);
-					insertQuery.bindValue(4, attempt.question);
-					insertQuery.bindValue(5, attempt.selectedAnswer);
-					insertQuery.bindValue(6, attempt.correctAnswer);
-					insertQuery.bindValue(7, attempt.correct ? 1 : 0);
-					insertQuery.bindValue(8, QJsonDocument(optionsArray).toJson(QJsonDocument::Compact));
-					insertQuery.bindValue(9, attempt.selectedIndex);
-
-					if (!insertQuery.exec()) {
-						errorMessage = insertQuery.lastError().text();
-						success = false;
-						break;
-					}
-				}
+bool UserManager::storeAttempts(QSqlDatabase &db,
+								const QString &nickname,
+								const QDateTime &sessionTimestamp,
+								const QVector<QuestionAttempt> &attempts,
+								QString &errorMessage) {
+	if (attempts.isEmpty()) {
+		return true;
+	}
 
-				if (success) {
-					db.commit();
-				} else {
-					db.rollback();
+	// An attempt is stored once: a replayed or retried write hits its
+	// attemptId and is skipped. Rows stored by reference have a NULL question,
+	// so the (user, session, time, question) key does not catch them.
+	QSqlQuery insertQuery(db);
+	insertQuery.prepare(QStringLiteral(
+		"INSERT INTO %1 "
+		"(userNickName, sessionTimestamp, attemptTimestamp, problemId, question, selectedAnswer, correctAnswer, wasCorrect, optionsJson, selectedIndex, "
+		"sessionTimestampMs, attemptTimestampMs, attemptId, correctIndex) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+		"ON CONFLICT DO NOTHING"
+	).arg(QString::fromLatin1(kHistoryTableName)));
+
+	QSqlQuery problemQuery(db);
+	problemQuery.setForwardOnly(true);
+	problemQuery.prepare(QStringLiteral(
+		"SELECT p.text, a.text, a.validity FROM problem p "
+		"LEFT JOIN problem_answer a ON a.problemId = p.id "
+		"WHERE p.id = ? ORDER BY a.ordinal"));
+
+	NavQueryTimer insertTimer("UserManager.storeAttempts", insertQuery);
+	for (const auto &attempt : attempts) {
+		// The text is only left out when the bank still has the problem
+		// exactly as it was answered.
+		bool byReference = false;
+		int correctIndex = -1;
+		if (attempt.problemId > 0 && attempt.selectedIndex >= 0) {
+			problemQuery.bindValue(0, attempt.problemId);
+			if (!problemQuery.exec()) {
+				errorMessage = problemQuery.lastError().text();
+				return false;
+			}
+			int position = 0;
+			byReference = true;
+			while (problemQuery.next()) {
+				if (position == 0 && problemQuery.value(0).toString() != attempt.question) {
+					byReference = false;
+				}
+				if (problemQuery.value(1).isNull()) {
+					continue;
+				}
+				const bool valid = problemQuery.value(2).toInt() != 0;
+				if (position >= attempt.options.size()
+					|| attempt.options.at(position).text != problemQuery.value(1).toString()
+					|| attempt.options.at(position).correct != valid) {
+					byReference = false;
+				}
+				if (correctIndex < 0 && valid) {
+					correctIndex = position;
 				}
+				++position;
+			}
+			problemQuery.finish();
+			if (position != attempt.options.size() || attempt.selectedIndex >= position) {
+				byReference = false;
 			}
 		}
-		db.close();
-	}
-	QSqlDatabase::removeDatabase(connection);
 
-	return success;
-}
+		QVariant optionsJson;
+		if (!byReference) {
+			QVector<Answer> options;
+			options.reserve(attempt.options.size());
+			for (const auto &option : attempt.options) {
+				options.push_back(Answer(option.text, option.correct));
+			}
+			optionsJson = NavOptionsCodec::encode(options);
+		}
+		const QVariant none;
+
+		insertQuery.bindValue(0, nickname);
+		insertQuery.bindValue(1, sessionKey(sessionTimestamp));
+		insertQuery.bindValue(2, attemptKey(attempt.timestamp));
+		insertQuery.bindValue(3, attempt.problemId);
+		insertQuery.bindValue(4, byReference ? none : QVariant(attempt.question));
+		insertQuery.bindValue(5, byReference ? none : QVariant(attempt.selectedAnswer));
+		insertQuery.bindValue(6, byReference ? none : QVariant(attempt.correctAnswer));
+		insertQuery.bindValue(7, attempt.correct ? 1 : 0);
+		insertQuery.bindValue(8, optionsJson);
+		insertQuery.bindValue(9, attempt.selectedIndex);
+		insertQuery.bindValue(10, sessionTimestamp.isValid() ? QVariant(sessionTimestamp.toMSecsSinceEpoch()) : QVariant());
+		insertQuery.bindValue(11, attempt.timestamp.isValid() ? QVariant(attempt.timestamp.toMSecsSinceEpoch()) : QVariant());
+		insertQuery.bindValue(12, attempt.id);
+		insertQuery.bindValue(13, byReference && correctIndex >= 0 ? QVariant(correctIndex) : none);
+
+		if (!insertQuery.exec()) {
+			errorMessage = insertQuery.lastError().text();
+			return false;
+		}
+		insertTimer.addRow();
+	}
 
-QString UserManager::historyConnectionName() const {
-	return QStringLiteral("per_history_%1_%2")
-		.arg(reinterpret_cast<quintptr>(this))
-		.arg(QUuid::createUuid().toString(QUuid::WithoutBraces));
+	return true;
 }
-